@@ -0,0 +1,106 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "ResourceEventClient.h"
+
+// Qt
+#include <QLocalSocket>
+
+// Local
+#include <common/socket/EventFraming.h>
+
+
+class ResourceEventClient::Private {
+public:
+    QLocalSocket socket;
+};
+
+ResourceEventClient::ResourceEventClient()
+    : d(new Private())
+{
+}
+
+ResourceEventClient::~ResourceEventClient()
+{
+    if (isConnected()) {
+        d->socket.flush();
+        d->socket.disconnectFromServer();
+    }
+}
+
+bool ResourceEventClient::connectToService(int msecs)
+{
+    if (isConnected()) {
+        return true;
+    }
+
+    d->socket.connectToServer(Common::EventFraming::socketPath(),
+                              QIODevice::WriteOnly);
+
+    return d->socket.waitForConnected(msecs);
+}
+
+bool ResourceEventClient::isConnected() const
+{
+    return d->socket.state() == QLocalSocket::ConnectedState;
+}
+
+bool ResourceEventClient::registerResourceEvent(const QString &application,
+                                                quint32 windowId,
+                                                const QString &uri,
+                                                quint32 event)
+{
+    if (!isConnected()) {
+        return false;
+    }
+
+    const auto frame = Common::EventFraming::encode(application, windowId,
+                                                    uri, event);
+
+    if (frame.isEmpty()) {
+        return false;
+    }
+
+    if (d->socket.write(frame) != frame.size()) {
+        return false;
+    }
+
+    // Writing what we can right away, without blocking
+    d->socket.flush();
+
+    return true;
+}
+
+bool ResourceEventClient::waitForEventsWritten(int msecs)
+{
+    if (!isConnected()) {
+        return false;
+    }
+
+    while (d->socket.bytesToWrite() > 0) {
+        if (!d->socket.waitForBytesWritten(msecs)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
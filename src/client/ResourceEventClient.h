@@ -0,0 +1,77 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCE_EVENT_CLIENT_H
+#define RESOURCE_EVENT_CLIENT_H
+
+#include "kactivitymanagerd_client_export.h"
+
+// Qt
+#include <QString>
+
+// STL
+#include <memory>
+
+
+/**
+ * Sends resource events to the activity manager through its
+ * local socket, skipping the session bus.
+ *
+ * The socket needs to be enabled in the service configuration
+ * (ingestion-socket in the Resources group). If it is not, the
+ * client fails to connect and the application should fall back
+ * to the org.kde.ActivityManager.Resources D-Bus interface.
+ *
+ * The events are the same as those of RegisterResourceEvent.
+ */
+class KACTIVITYMANAGERD_CLIENT_EXPORT ResourceEventClient {
+public:
+    ResourceEventClient();
+    ~ResourceEventClient();
+
+    /**
+     * Connects to the service, blocking for at most the specified time
+     */
+    bool connectToService(int msecs = 1000);
+
+    bool isConnected() const;
+
+    /**
+     * Sends an event. The event is written without waiting for
+     * the service to read it.
+     * @returns false if the client is not connected, or if
+     *          the event could not be encoded
+     */
+    bool registerResourceEvent(const QString &application, quint32 windowId,
+                               const QString &uri, quint32 event);
+
+    /**
+     * Blocks until all the pending events are written to the socket.
+     * Only needed by the applications without an event loop
+     */
+    bool waitForEventsWritten(int msecs = 1000);
+
+private:
+    // This header is installed, so it can not use utils/d_ptr.h
+    class Private;
+    const std::unique_ptr<Private> d;
+};
+
+#endif // RESOURCE_EVENT_CLIENT_H
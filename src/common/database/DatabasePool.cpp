@@ -0,0 +1,235 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DatabasePool.h"
+
+#include <utils/d_ptr_implementation.h>
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "DebugResources.h"
+
+namespace Common {
+
+namespace {
+    struct Task {
+        DatabasePool::Job job;
+        QElapsedTimer queued;
+    };
+
+    struct Queue {
+        Queue()
+            : quit(false)
+        {
+        }
+
+        QMutex mutex;
+        QWaitCondition condition;
+        std::deque<Task> tasks[DatabasePool::PriorityCount];
+        bool quit;
+
+        bool isEmpty() const
+        {
+            for (const auto &queue: tasks) {
+                if (!queue.empty()) return false;
+            }
+
+            return true;
+        }
+
+        Task take()
+        {
+            for (auto &queue: tasks) {
+                if (!queue.empty()) {
+                    Task task = std::move(queue.front());
+                    queue.pop_front();
+                    return task;
+                }
+            }
+
+            Q_UNREACHABLE();
+        }
+    };
+
+    struct Statistics {
+        Statistics()
+            : jobs(0)
+            , waitTime(0)
+            , busyTime(0)
+        {
+            lifetime.start();
+        }
+
+        std::atomic<quint64> jobs;
+        std::atomic<quint64> waitTime; // us
+        std::atomic<quint64> busyTime; // ns
+        QElapsedTimer lifetime;
+    };
+
+    class Connection : public QThread {
+    public:
+        Connection(Queue &queue, Statistics &statistics)
+            : queue(queue)
+            , statistics(statistics)
+        {
+        }
+
+        void run() override
+        {
+            // Opening the connection right away, so that the first
+            // job does not have to wait for it. This fails if the
+            // database does not exist yet, so we are trying again
+            // with each job.
+            open();
+
+            forever {
+                Task task;
+
+                {
+                    QMutexLocker lock(&queue.mutex);
+
+                    while (!queue.quit && queue.isEmpty()) {
+                        queue.condition.wait(&queue.mutex);
+                    }
+
+                    if (queue.quit) break;
+
+                    task = queue.take();
+                }
+
+                statistics.waitTime += task.queued.nsecsElapsed() / 1000;
+
+                QElapsedTimer timer;
+                timer.start();
+
+                if (!database) {
+                    open();
+                }
+
+                task.job(database.get());
+
+                ++statistics.jobs;
+                statistics.busyTime += timer.nsecsElapsed();
+            }
+
+            // The connection needs to be closed in its own thread
+            database.reset();
+        }
+
+    private:
+        void open()
+        {
+            database = Database::instance(Database::ResourcesDatabase,
+                                          Database::ReadOnly);
+
+            if (!database) {
+                qCWarning(KAMD_LOG_RESOURCES)
+                    << "DatabasePool: Can not open the database";
+                return;
+            }
+
+            // The readers do not write anything (query_only is set
+            // by Database), and they can map the file instead of
+            // copying the pages into the cache
+            database->setPragma(QStringLiteral("mmap_size = 67108864"));
+        }
+
+        Queue &queue;
+        Statistics &statistics;
+        Database::Ptr database;
+    };
+}
+
+class DatabasePool::Private {
+public:
+    Queue queue;
+    Statistics statistics;
+    std::vector<std::unique_ptr<Connection>> connections;
+};
+
+DatabasePool::DatabasePool(int size)
+    : d()
+{
+    for (int i = 0; i < qMax(1, size); ++i) {
+        d->connections.emplace_back(
+            new Connection(d->queue, d->statistics));
+        d->connections.back()->start();
+    }
+}
+
+DatabasePool::~DatabasePool()
+{
+    // The jobs that have not started yet are dropped
+    {
+        QMutexLocker lock(&d->queue.mutex);
+        d->queue.quit = true;
+        d->queue.condition.wakeAll();
+    }
+
+    for (const auto &connection: d->connections) {
+        connection->wait();
+    }
+}
+
+int DatabasePool::size() const
+{
+    return (int)d->connections.size();
+}
+
+void DatabasePool::execute(int priority, const Job &job)
+{
+    Task task;
+    task.job = job;
+    task.queued.start();
+
+    QMutexLocker lock(&d->queue.mutex);
+    d->queue.tasks[qBound(0, priority, PriorityCount - 1)]
+        .push_back(std::move(task));
+    d->queue.condition.wakeOne();
+}
+
+quint64 DatabasePool::jobs() const
+{
+    return d->statistics.jobs;
+}
+
+quint64 DatabasePool::waitTime() const
+{
+    return d->statistics.waitTime;
+}
+
+double DatabasePool::utilization() const
+{
+    const auto available =
+        double(d->statistics.lifetime.nsecsElapsed()) * size();
+
+    return available > 0 ? d->statistics.busyTime / available : 0.0;
+}
+
+} // namespace Common
@@ -0,0 +1,76 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_DATABASE_POOL_H
+#define COMMON_DATABASE_POOL_H
+
+#include <utils/d_ptr.h>
+#include <functional>
+#include "Database.h"
+
+namespace Common {
+
+/**
+ * A set of warm read-only database connections, each of them living in
+ * its own thread. The writes go through the single read-write connection
+ * of the service, not through the pool. The connections can not be shared between the threads, so
+ * instead of handing out the connections, the pool executes the jobs
+ * in the threads that own them.
+ *
+ * The jobs are taken by the priority, and in the order in which they
+ * were queued for the same priority.
+ */
+class DatabasePool {
+public:
+    enum {
+        PriorityCount = 3
+    };
+
+    /**
+     * The job gets a null pointer if the connection can not be opened
+     */
+    typedef std::function<void (Database *database)> Job;
+
+    explicit DatabasePool(int size);
+    ~DatabasePool();
+
+    int size() const;
+
+    /**
+     * Queues the job
+     * @param priority zero is the highest priority
+     */
+    void execute(int priority, const Job &job);
+
+    // These can be called from any thread
+    quint64 jobs() const;
+    quint64 waitTime() const; // us, total
+
+    // The part of the time the connections were in use since
+    // the pool was created
+    double utilization() const;
+
+private:
+    D_PTR;
+};
+
+} // namespace Common
+
+#endif // COMMON_DATABASE_POOL_H
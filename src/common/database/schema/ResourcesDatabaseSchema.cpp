@@ -23,6 +23,11 @@
 #include <QStandardPaths>
 #include <QVariant>
 #include <QCoreApplication>
+#include <QFileInfo>
+#include <QSqlError>
+#include <QSqlQuery>
+
+#include "DebugResources.h"
 
 namespace Common {
 namespace ResourcesDatabaseSchema {
@@ -31,7 +36,7 @@ const QString name = QStringLiteral("Resources");
 
 QString version()
 {
-    return QStringLiteral("2015.02.09");
+    return QStringLiteral("2026.10.15");
 }
 
 QStringList schema()
@@ -41,13 +46,12 @@ QStringList schema()
     return QStringList()
 
         << // Schema informations table, used for versioning
+           // The version is written by initSchema, once the
+           // migrations of the existing data are done
            QStringLiteral("CREATE TABLE IF NOT EXISTS SchemaInfo ("
                "key text PRIMARY KEY, value text"
            ")")
 
-        << QStringLiteral("INSERT OR IGNORE INTO schemaInfo VALUES ('version', '%1')").arg(version())
-        << QStringLiteral("UPDATE schemaInfo SET value = '%1' WHERE key = 'version'").arg(version())
-
 
         << // The ResourceEvent table saves the Opened/Closed event pairs for
            // a resource. The Accessed event is mapped to those.
@@ -58,11 +62,17 @@ QStringList schema()
                "initiatingAgent TEXT, "
                "targettedResource TEXT, "
                "start INTEGER, "
-               "end INTEGER "
+               "end INTEGER, "
+               "targettedPath INTEGER "
            ")")
 
         << // The ResourceScoreCache table stores the calcualted scores
            // for resources based on the recorded events.
+           // @since 2026.10.15
+           // The tables that have text primary keys are stored as clustered
+           // indices, ordered by the usual lookup prefix - the activity,
+           // the agent and then the resource. Otherwise, sqlite keeps each
+           // row twice - in the table and in the index of the key.
            QStringLiteral("CREATE TABLE IF NOT EXISTS ResourceScoreCache ("
                "usedActivity TEXT, "
                "initiatingAgent TEXT, "
@@ -71,8 +81,9 @@ QStringList schema()
                "cachedScore FLOAT, "
                "firstUpdate INTEGER, "
                "lastUpdate INTEGER, "
+               "targettedPath INTEGER, "
                "PRIMARY KEY(usedActivity, initiatingAgent, targettedResource)"
-           ")")
+           ") WITHOUT ROWID")
 
 
         << // @since 2014.05.05
@@ -85,8 +96,9 @@ QStringList schema()
                "usedActivity TEXT, "
                "initiatingAgent TEXT, "
                "targettedResource TEXT, "
+               "targettedPath INTEGER, "
                "PRIMARY KEY(usedActivity, initiatingAgent, targettedResource)"
-           ")")
+           ") WITHOUT ROWID")
 
         << // @since 2015.01.18
            // The ResourceInfo table stores the collected information about a
@@ -101,9 +113,47 @@ QStringList schema()
                "mimetype TEXT, "
                "autoTitle INTEGER, "
                "autoMimetype INTEGER, "
+               "targettedPath INTEGER, "
                "PRIMARY KEY(targettedResource)"
+           ") WITHOUT ROWID")
+
+        << // @since 2026.10.10
+           // The ResourcePath table is a tree of the path segments of
+           // the local resources. The other tables reference the leaves
+           // through their targettedPath columns.
+           // The pathKey is the chain of the ids from the root, like
+           // '/3/17/42/', so that everything under a directory can be
+           // found with a range scan.
+           QStringLiteral("CREATE TABLE IF NOT EXISTS ResourcePath ("
+               "id INTEGER PRIMARY KEY, "
+               "parent INTEGER, "
+               "segment TEXT, "
+               "pathKey TEXT, "
+               "UNIQUE(parent, segment)"
            ")")
 
+        << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourcePathKey "
+               "ON ResourcePath (pathKey)")
+
+        << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceEventPath "
+               "ON ResourceEvent (targettedPath)")
+
+        << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceScoreCachePath "
+               "ON ResourceScoreCache (targettedPath)")
+
+        << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceLinkPath "
+               "ON ResourceLink (targettedPath)")
+
+        << // @since 2026.10.12
+           // Deleting the stats of a resource, or of the resources with
+           // a common prefix, and collecting the events of a resource
+           // for its score should not need to scan the whole tables
+           QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceEventResource "
+               "ON ResourceEvent (targettedResource)")
+
+        << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceScoreCacheResource "
+               "ON ResourceScoreCache (targettedResource)")
+
        ;
 }
 
@@ -136,6 +186,154 @@ void overridePath(const QString &path)
     app->setProperty(overrideFileProperty, path);
 }
 
+namespace {
+    // Copies the table into a new one with the specified layout.
+    // The new table needs to have all the columns listed.
+    // Returns false, and keeps the old table, if the copy failed
+    bool rebuildTable(Database &database, const QString &table,
+                      const QString &layout, const QString &columns)
+    {
+        DATABASE_TRANSACTION(database);
+
+        const QString newTable = table + QStringLiteral("Rebuilt");
+
+        database.execQuery(
+            QStringLiteral("DROP TABLE IF EXISTS %1").arg(newTable));
+        database.execQuery(
+            QStringLiteral("CREATE TABLE %1 %2").arg(newTable, layout));
+
+        // The rows that have nulls in their keys, or that are
+        // duplicates because of these, are skipped
+        const auto copied = database.execQuery(
+            QStringLiteral("INSERT OR IGNORE INTO %1 (%3) SELECT %3 FROM %2")
+                .arg(newTable, table, columns));
+
+        if (copied.lastError().isValid()) {
+            // Keeping the old table as it was
+            qCWarning(KAMD_LOG_RESOURCES) << "Failed to rebuild" << table
+                                          << copied.lastError();
+            database.execQuery(QStringLiteral("DROP TABLE %1").arg(newTable));
+            return false;
+        }
+
+        database.execQuery(QStringLiteral("DROP TABLE %1").arg(table));
+        database.execQuery(QStringLiteral("ALTER TABLE %1 RENAME TO %2")
+                               .arg(newTable, table));
+
+        return true;
+    }
+
+    // Migrates the data of an existing database to the current schema.
+    // Returns false if some of the steps failed, and the migration
+    // needs to be tried again on the next start
+    bool migrate(Database &database, const QString &dbSchemaVersion)
+    {
+        bool succeeded = true;
+
+        // We can not allow empty fields for activity and agent, they need to
+        // be at least magic values. These do not change the structure
+        // of the database, but the old data.
+        if (dbSchemaVersion < QStringLiteral("2015.02.09")) {
+            const QString updateActivity =
+                QStringLiteral("SET usedActivity=':global' "
+                "WHERE usedActivity IS NULL OR usedActivity = ''");
+
+            const QString updateAgent =
+                QStringLiteral("SET initiatingAgent=':global' "
+                "WHERE initiatingAgent IS NULL OR initiatingAgent = ''");
+
+            // When the activity field was empty, it meant the file was
+            // linked to all activities (aka :global)
+            database.execQuery("UPDATE ResourceLink " + updateActivity);
+
+            // When the agent field was empty, it meant the file was not
+            // linked to a specified agent (aka :global)
+            database.execQuery("UPDATE ResourceLink " + updateAgent);
+
+            // These were not supposed to be empty, but in the case they were,
+            // deal with them as well
+            database.execQuery("UPDATE ResourceEvent " + updateActivity);
+            database.execQuery("UPDATE ResourceEvent " + updateAgent);
+            database.execQuery("UPDATE ResourceScoreCache " + updateActivity);
+            database.execQuery("UPDATE ResourceScoreCache " + updateAgent);
+        }
+
+        // The existing rows are filled by the plugin, it knows how to
+        // split the paths - here we just reset the flag that says
+        // they are filled.
+        if (dbSchemaVersion < QStringLiteral("2026.10.10")) {
+            database.execQuery(QStringLiteral(
+                "DELETE FROM SchemaInfo WHERE key = 'resourcePathsFilled'"));
+        }
+
+        // The tables created before the clustered layouts from schema()
+        // are copied into the new layouts
+        if (dbSchemaVersion < QStringLiteral("2026.10.15")) {
+            const auto sizeBefore = QFileInfo(path()).size();
+
+            succeeded &= rebuildTable(database, QStringLiteral("ResourceScoreCache"),
+                QStringLiteral("("
+                    "usedActivity TEXT, "
+                    "initiatingAgent TEXT, "
+                    "targettedResource TEXT, "
+                    "scoreType INTEGER, "
+                    "cachedScore FLOAT, "
+                    "firstUpdate INTEGER, "
+                    "lastUpdate INTEGER, "
+                    "targettedPath INTEGER, "
+                    "PRIMARY KEY(usedActivity, initiatingAgent, targettedResource)"
+                ") WITHOUT ROWID"),
+                QStringLiteral("usedActivity, initiatingAgent, targettedResource, "
+                               "scoreType, cachedScore, firstUpdate, lastUpdate, "
+                               "targettedPath"));
+
+            succeeded &= rebuildTable(database, QStringLiteral("ResourceLink"),
+                QStringLiteral("("
+                    "usedActivity TEXT, "
+                    "initiatingAgent TEXT, "
+                    "targettedResource TEXT, "
+                    "targettedPath INTEGER, "
+                    "PRIMARY KEY(usedActivity, initiatingAgent, targettedResource)"
+                ") WITHOUT ROWID"),
+                QStringLiteral("usedActivity, initiatingAgent, targettedResource, "
+                               "targettedPath"));
+
+            succeeded &= rebuildTable(database, QStringLiteral("ResourceInfo"),
+                QStringLiteral("("
+                    "targettedResource TEXT, "
+                    "title TEXT, "
+                    "mimetype TEXT, "
+                    "autoTitle INTEGER, "
+                    "autoMimetype INTEGER, "
+                    "targettedPath INTEGER, "
+                    "PRIMARY KEY(targettedResource)"
+                ") WITHOUT ROWID"),
+                QStringLiteral("targettedResource, title, mimetype, "
+                               "autoTitle, autoMimetype, targettedPath"));
+
+            // The indices were dropped with the old tables
+            database.execQueries(QStringList()
+                << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceScoreCachePath "
+                       "ON ResourceScoreCache (targettedPath)")
+                << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceScoreCacheResource "
+                       "ON ResourceScoreCache (targettedResource)")
+                << QStringLiteral("CREATE INDEX IF NOT EXISTS ResourceLinkPath "
+                       "ON ResourceLink (targettedPath)"));
+
+            // The pages of the old tables are just marked as free,
+            // the file gets smaller only when it is rebuilt
+            database.execQuery(QStringLiteral("VACUUM"));
+
+            qCDebug(KAMD_LOG_RESOURCES) << "Rebuilt the tables without rowids,"
+                                        << "the database went from" << sizeBefore
+                                        << "to" << QFileInfo(path()).size()
+                                        << "bytes";
+        }
+
+        return succeeded;
+    }
+}
+
 void initSchema(Database &database)
 {
     QString dbSchemaVersion;
@@ -168,36 +366,43 @@ void initSchema(Database &database)
             /* ignore error */ true);
     }
 
-    database.execQueries(ResourcesDatabaseSchema::schema());
+    // A new database gets the current layout from schema(),
+    // there is nothing to migrate
+    const bool isNewDatabase = !database.execQuery(
+        QStringLiteral("SELECT name FROM sqlite_master "
+                       "WHERE type = 'table' AND name = 'ResourceEvent'"),
+        /* ignore error */ true).next();
+
+    // The local resources get a reference to their ResourcePath node.
+    // The column needs to exist before schema() creates the indices on it.
+    if (!isNewDatabase && dbSchemaVersion < QStringLiteral("2026.10.10")) {
+        for (const auto &table: { QStringLiteral("ResourceEvent"),
+                                  QStringLiteral("ResourceScoreCache"),
+                                  QStringLiteral("ResourceLink"),
+                                  QStringLiteral("ResourceInfo") }) {
+            // This fails if we are coming back from an older version
+            // that left the column in place
+            database.execQuery(
+                QStringLiteral("ALTER TABLE %1 ADD COLUMN targettedPath INTEGER")
+                    .arg(table),
+                /* ignore error */ true);
+        }
+    }
 
-    // We can not allow empty fields for activity and agent, they need to
-    // be at least magic values. These do not change the structure
-    // of the database, but the old data.
-    if (dbSchemaVersion < QStringLiteral("2015.02.09")) {
-        const QString updateActivity =
-            QStringLiteral("SET usedActivity=':global' "
-            "WHERE usedActivity IS NULL OR usedActivity = ''");
-
-        const QString updateAgent =
-            QStringLiteral("SET initiatingAgent=':global' "
-            "WHERE initiatingAgent IS NULL OR initiatingAgent = ''");
-
-        // When the activity field was empty, it meant the file was
-        // linked to all activities (aka :global)
-        database.execQuery("UPDATE ResourceLink " + updateActivity);
-
-        // When the agent field was empty, it meant the file was not
-        // linked to a specified agent (aka :global)
-        database.execQuery("UPDATE ResourceLink " + updateAgent);
-
-        // These were not supposed to be empty, but in the case they were,
-        // deal with them as well
-        database.execQuery("UPDATE ResourceEvent " + updateActivity);
-        database.execQuery("UPDATE ResourceEvent " + updateAgent);
-        database.execQuery("UPDATE ResourceScoreCache " + updateActivity);
-        database.execQuery("UPDATE ResourceScoreCache " + updateAgent);
+    database.execQueries(ResourcesDatabaseSchema::schema());
 
+    if (!isNewDatabase && !migrate(database, dbSchemaVersion)) {
+        qCWarning(KAMD_LOG_RESOURCES) << "The database migration from"
+                                      << dbSchemaVersion << "has failed,"
+                                      << "it will be tried again on the next start";
+        return;
     }
+
+    // Only now the database is really at the current version. If the
+    // migration gets interrupted or fails, it is run again on the next start
+    database.execQuery(
+        QStringLiteral("INSERT OR REPLACE INTO SchemaInfo VALUES ('version', '%1')")
+            .arg(version()));
 }
 
 } // namespace Common
@@ -31,6 +31,9 @@ public:
     {
         qDBusRegisterMetaType<ActivityInfo>();
         qDBusRegisterMetaType<ActivityInfoList>();
+        qDBusRegisterMetaType<ActivityChangeMap>();
+        qDBusRegisterMetaType<ActivityChange>();
+        qDBusRegisterMetaType<ActivityChangeList>();
     }
 
     static ActivityInfoStaticInit _instance;
@@ -75,3 +78,27 @@ QDebug operator<<(QDebug dbg, const ActivityInfo &r)
     dbg << "ActivityInfo(" << r.id << r.name << ")";
     return dbg.space();
 }
+
+QDBusArgument &operator<<(QDBusArgument &arg, const ActivityChange r)
+{
+    arg.beginStructure();
+
+    arg << r.id;
+    arg << r.changes;
+
+    arg.endStructure();
+
+    return arg;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &arg, ActivityChange &r)
+{
+    arg.beginStructure();
+
+    arg >> r.id;
+    arg >> r.changes;
+
+    arg.endStructure();
+
+    return arg;
+}
@@ -24,6 +24,8 @@
 
 #include <QString>
 #include <QList>
+#include <QMap>
+#include <QVariantMap>
 #include <QDBusArgument>
 #include <QDebug>
 
@@ -50,12 +52,44 @@ struct ActivityInfo {
 
 typedef QList<ActivityInfo> ActivityInfoList;
 
+// What has changed in an activity since the last ActivitiesChanged signal
+struct ActivityChange {
+    enum Change {
+        Added       = 0x01,
+        Removed     = 0x02,
+        Name        = 0x04,
+        Description = 0x08,
+        Icon        = 0x10,
+        State       = 0x20
+    };
+
+    QString id;
+    int changes;
+
+    ActivityChange(const QString &id = QString(), int changes = 0)
+        : id(id)
+        , changes(changes)
+    {
+    }
+};
+
+typedef QList<ActivityChange> ActivityChangeList;
+
+// Changes of multiple activities, keyed by the activity id
+typedef QMap<QString, QVariantMap> ActivityChangeMap;
+
 Q_DECLARE_METATYPE(ActivityInfo)
 Q_DECLARE_METATYPE(ActivityInfoList)
+Q_DECLARE_METATYPE(ActivityChange)
+Q_DECLARE_METATYPE(ActivityChangeList)
+Q_DECLARE_METATYPE(ActivityChangeMap)
 
 QDBusArgument &operator<<(QDBusArgument &arg, const ActivityInfo);
 const QDBusArgument &operator>>(const QDBusArgument &arg, ActivityInfo &rec);
 
 QDebug operator<<(QDebug dbg, const ActivityInfo &r);
 
+QDBusArgument &operator<<(QDBusArgument &arg, const ActivityChange);
+const QDBusArgument &operator>>(const QDBusArgument &arg, ActivityChange &rec);
+
 #endif // KAMD_ACTIVITIES_DBUS_H
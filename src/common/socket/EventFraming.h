@@ -0,0 +1,167 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMON_EVENT_FRAMING_H
+#define COMMON_EVENT_FRAMING_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStandardPaths>
+#include <QtEndian>
+
+namespace Common {
+namespace EventFraming {
+
+    // The framing used by the local ingestion socket.
+    //
+    // Every frame starts with a quint32 payload size, followed by:
+    //   quint8  protocol version
+    //   quint8  event type
+    //   quint32 window id
+    //   quint16 size of the application name, followed by the name
+    //   quint32 size of the uri, followed by the uri
+    //
+    // The integers are little-endian, the strings are UTF-8
+
+    const quint8 version = 1;
+
+    const int sizeSize = sizeof(quint32);
+    const int fixedSize = 1 + 1 + 4 + 2 + 4;
+
+    // Frames bigger than this are treated as a protocol violation
+    const quint32 maxPayloadSize = 64 * 1024;
+
+    inline QString socketPath()
+    {
+        return QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation)
+               + QStringLiteral("/kactivitymanagerd/resources.socket");
+    }
+
+    struct Frame {
+        QString application;
+        quint32 windowId;
+        QString uri;
+        quint32 type;
+    };
+
+    namespace detail {
+        template <typename T>
+        inline void append(QByteArray &data, T value)
+        {
+            const int size = data.size();
+            data.resize(size + (int)sizeof(T));
+            qToLittleEndian(value, reinterpret_cast<uchar *>(data.data() + size));
+        }
+
+        template <typename T>
+        inline T take(const uchar *&data)
+        {
+            const T value = qFromLittleEndian<T>(data);
+            data += sizeof(T);
+            return value;
+        }
+    }
+
+    /**
+     * Creates a frame for the event, including the size prefix.
+     * Returns an empty array if the event can not be encoded
+     */
+    inline QByteArray encode(const QString &application, quint32 windowId,
+                             const QString &uri, quint32 type)
+    {
+        const auto applicationData = application.toUtf8();
+        const auto uriData = uri.toUtf8();
+
+        const quint32 payloadSize
+            = fixedSize + applicationData.size() + uriData.size();
+
+        if (type > 0xff || applicationData.size() > 0xffff
+            || payloadSize > maxPayloadSize) {
+            return QByteArray();
+        }
+
+        QByteArray result;
+        result.reserve(sizeSize + payloadSize);
+
+        detail::append<quint32>(result, payloadSize);
+        detail::append<quint8>(result, version);
+        detail::append<quint8>(result, type);
+        detail::append<quint32>(result, windowId);
+        detail::append<quint16>(result, applicationData.size());
+        result.append(applicationData);
+        detail::append<quint32>(result, uriData.size());
+        result.append(uriData);
+
+        return result;
+    }
+
+    /**
+     * Reads the payload size from the frame prefix
+     */
+    inline quint32 payloadSize(const char *prefix)
+    {
+        return qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(prefix));
+    }
+
+    /**
+     * Decodes the payload of a frame, without the size prefix.
+     * Returns false if the payload is malformed
+     */
+    inline bool decode(const QByteArray &payload, Frame &frame)
+    {
+        if (payload.size() < fixedSize) {
+            return false;
+        }
+
+        auto data = reinterpret_cast<const uchar *>(payload.constData());
+        const auto end = data + payload.size();
+
+        if (detail::take<quint8>(data) != version) {
+            return false;
+        }
+
+        frame.type = detail::take<quint8>(data);
+        frame.windowId = detail::take<quint32>(data);
+
+        const quint16 applicationSize = detail::take<quint16>(data);
+
+        if (end - data < applicationSize + 4) {
+            return false;
+        }
+
+        frame.application = QString::fromUtf8(
+            reinterpret_cast<const char *>(data), applicationSize);
+        data += applicationSize;
+
+        const quint32 uriSize = detail::take<quint32>(data);
+
+        if ((quint32)(end - data) != uriSize) {
+            return false;
+        }
+
+        frame.uri = QString::fromUtf8(reinterpret_cast<const char *>(data), uriSize);
+
+        return true;
+    }
+
+} // namespace EventFraming
+} // namespace Common
+
+#endif // COMMON_EVENT_FRAMING_H
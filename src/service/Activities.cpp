@@ -30,20 +30,25 @@
 #include <QStandardPaths>
 #include <QFile>
 #include <QUuid>
+#include <QElapsedTimer>
 
 // KDE
 #include <kdbusconnectionpool.h>
 #include <klocalizedstring.h>
 #include <kauthorized.h>
 #include <kdelibs4migration.h>
+#include <kconfig.h>
+#include <kconfiggroup.h>
 #include <ksharedconfig.h>
 
 // Utils
 #include <utils/d_ptr_implementation.h>
-#include <utils/range.h>
 
 // Local
 #include "DebugActivities.h"
+#include "ActivitiesSnapshot.h"
+#include "StartupProfiler.h"
+#include "SwitchTrace.h"
 #include "activitiesadaptor.h"
 #include "ksmserver/KSMServer.h"
 #include "common/dbus/common.h"
@@ -53,6 +58,8 @@
 
 Activities::Private::KDE4ConfigurationTransitionChecker::KDE4ConfigurationTransitionChecker()
 {
+    StartupProfiler::Phase phase(QStringLiteral("activities/kde4-migration-check"));
+
     // Checking whether we need to transfer the KActivities/KDE4
     // configuration file to the new location.
     const QString newConfigLocation
@@ -77,38 +84,54 @@ Activities::Private::KDE4ConfigurationTransitionChecker::KDE4ConfigurationTransi
 
 Activities::Private::Private(Activities *parent)
     : kde4ConfigurationTransitionChecker()
-    , config(QStringLiteral("kactivitymanagerdrc"))
+    , changesSequence(0)
     , q(parent)
 {
-    // qCDebug(KAMD_ACTIVITIES) << "Using this configuration file:"
-    //     << config.name()
-    //     << config.locationType()
-    //     << QStandardPaths::standardLocations(config.locationType())
-    //     ;
+    QElapsedTimer timer;
+    timer.start();
+
+    // Reading the activities from the store if it is up-to-date,
+    // otherwise importing them from the config file
+    ActivityStore::Data data;
+    bool fromStore;
+
+    {
+        StartupProfiler::Phase phase(QStringLiteral("activities/store-load"));
+        fromStore = store.isNewerThanConfig() && store.load(data);
+    }
+
+    if (!fromStore) {
+        StartupProfiler::Phase phase(QStringLiteral("activities/config-parse"));
+
+        KConfig config(ActivityStore::configFileName());
+        ActivityStore::importConfig(config, data);
 
-    // Reading activities from the config file.
-    // Saving only the running activities means that if we have any
-    // errors in the config, we might end up with all activities
-    // stopped
+        if (!data.activities.isEmpty()) {
+            store.save(data);
+        }
+    }
+
+    // The saving is delayed for at least a second after the last
+    // change, but not for longer than the configured maximum
+    const auto maximumSaveDelay
+        = ActivityStore::settings()
+              ->group("main").readEntry("maximumSaveDelay", 5000);
+
+    writer.reset(new ActivityStoreWriter(store, 1000, maximumSaveDelay));
 
-    const auto defaultState
-        = !mainConfig().hasKey("runningActivities") ? Activities::Running :
-          !mainConfig().hasKey("stoppedActivities") ? Activities::Stopped :
-                                                      Activities::Running;
+    metadata = data.activities;
+    lastActivity = data.currentActivity;
 
-    const auto runningActivities
-        = mainConfig().readEntry("runningActivities", QStringList()).toSet();
-    const auto stoppedActivities
-        = mainConfig().readEntry("stoppedActivities", QStringList()).toSet();
+    const auto stoppedActivities = data.stoppedActivities.toSet();
 
     // Do we have a running activity?
     bool atLeastOneRunning = false;
 
-    for (const auto &activity: activityNameConfig().keyList()) {
-        auto state =
-            runningActivities.contains(activity) ? Activities::Running :
-            stoppedActivities.contains(activity) ? Activities::Stopped :
-                                                   defaultState;
+    for (auto it = metadata.cbegin(); it != metadata.cend(); ++it) {
+        const auto &activity = it.key();
+
+        auto state = stoppedActivities.contains(activity) ? Activities::Stopped
+                                                          : Activities::Running;
 
         activities[activity] = state;
 
@@ -117,6 +140,10 @@ Activities::Private::Private(Activities *parent)
         }
     }
 
+    qCDebug(KAMD_LOG_ACTIVITIES) << "Loaded" << activities.size() << "activities from the"
+                                 << (fromStore ? "store" : "config file")
+                                 << "in" << timer.elapsed() << "ms";
+
     // Is this our first start?
     if (activities.isEmpty()) {
         // We need to add this only after the service has been properly started
@@ -143,6 +170,83 @@ Activities::Private::Private(Activities *parent)
             activities[keys] = Activities::Running;
         }
     }
+
+    // Nobody else can access the activities yet
+    publishSnapshot();
+    invalidateInformation();
+}
+
+ActivityStore::Data Activities::Private::storeData()
+{
+    ActivityStore::Data data;
+
+    QReadLocker lock(&activitiesLock);
+
+    data.activities = metadata;
+    data.stoppedActivities = activities.keys(Activities::Stopped)
+                             + activities.keys(Activities::Stopping);
+    data.currentActivity = currentActivity;
+
+    return data;
+}
+
+void Activities::Private::publishSnapshot()
+{
+    QHash<QString, int> states;
+    states.reserve(activities.size());
+
+    for (auto it = activities.cbegin(); it != activities.cend(); ++it) {
+        states[it.key()] = it.value();
+    }
+
+    ActivitiesSnapshot::publish(currentActivity, states);
+}
+
+void Activities::Private::invalidateInformation()
+{
+    informationOutdated = true;
+}
+
+std::shared_ptr<const Activities::Private::Information>
+Activities::Private::currentInformation()
+{
+    if (informationOutdated) {
+        QMutexLocker informationLock(&informationMutex);
+
+        // Another thread might have rebuilt it while we were waiting.
+        // The flag is cleared before the activities are read, a change
+        // that is made after that sets it again
+        if (informationOutdated.exchange(false)) {
+            auto information = std::make_shared<Information>();
+
+            QReadLocker lock(&activitiesLock);
+
+            information->list.reserve(activities.size());
+            information->byId.reserve(activities.size());
+
+            for (auto it = activities.cbegin(); it != activities.cend(); ++it) {
+                const auto &activity = it.key();
+
+                const auto properties = metadata.value(activity);
+
+                const ActivityInfo info {
+                    activity,
+                    properties.name,
+                    properties.description,
+                    properties.icon,
+                    it.value()
+                };
+
+                information->list << info;
+                information->byId[activity] = info;
+            }
+
+            std::atomic_store(&this->information,
+                std::shared_ptr<const Information>(std::move(information)));
+        }
+    }
+
+    return std::atomic_load(&information);
 }
 
 void Activities::Private::loadLastActivity()
@@ -150,8 +254,7 @@ void Activities::Private::loadLastActivity()
     // This is called from constructor, no need for locking
 
     // If there are no public activities, try to load the last used activity
-    const auto lastUsedActivity
-        = mainConfig().readEntry("currentActivity", QString());
+    const auto lastUsedActivity = lastActivity;
 
     setCurrentActivity(
         (lastUsedActivity.isEmpty() && activities.size() > 0)
@@ -178,6 +281,7 @@ bool Activities::Private::setCurrentActivity(const QString &activity)
         // If the activity is empty, this means we are entering a limbo state
         if (activity.isEmpty()) {
             currentActivity.clear();
+            publishSnapshot();
             emit q->CurrentActivityChanged(currentActivity);
             return true;
         }
@@ -188,19 +292,27 @@ bool Activities::Private::setCurrentActivity(const QString &activity)
         }
     }
 
+    const auto switchId = SwitchTrace::begin(activity);
+
     // Start activity
-    q->StartActivity(activity);
+    startActivity(activity, switchId);
 
     // Saving the current activity, and notifying
     // clients of the change
-    currentActivity = activity;
+    {
+        QWriteLocker lock(&activitiesLock);
+        currentActivity = activity;
+        publishSnapshot();
+    }
 
-    mainConfig().writeEntry("currentActivity", activity);
+    SwitchTrace::mark(switchId, QStringLiteral("published"));
 
     scheduleConfigSync();
 
     emit q->CurrentActivityChanged(activity);
 
+    SwitchTrace::mark(switchId, QStringLiteral("signalled"));
+
     return true;
 }
 
@@ -228,13 +340,18 @@ QString Activities::Private::addActivity(const QString &name)
 
         activities[activity] = Invalid;
         activitiesCount = activities.size();
+
+        publishSnapshot();
     }
 
+    invalidateInformation();
+
     setActivityState(activity, Running);
 
     q->SetActivityName(activity, name);
 
     emit q->ActivityAdded(activity);
+    recordChange(activity, ActivityChange::Added);
 
     scheduleConfigSync();
 
@@ -274,53 +391,72 @@ void Activities::Private::removeActivity(const QString &activity)
         QWriteLocker lock(&activitiesLock);
         // Removing the activity
         activities.remove(activity);
+        metadata.remove(activity);
 
         // If the removed activity was the current one,
         // set another activity as current
         currentActivityDeleted = (currentActivity == activity);
+
+        publishSnapshot();
     }
 
-    activityNameConfig().deleteEntry(activity);
-    activityDescriptionConfig().deleteEntry(activity);
-    activityIconConfig().deleteEntry(activity);
+    invalidateInformation();
 
     if (currentActivityDeleted) {
         ensureCurrentActivityIsRunning();
     }
 
     emit q->ActivityRemoved(activity);
-
-    QMetaObject::invokeMethod(q, "ActivityRemoved", Qt::QueuedConnection,
-                              Q_ARG(QString, activity));
+    recordChange(activity, ActivityChange::Removed);
 
     QMetaObject::invokeMethod(this, "configSync", Qt::QueuedConnection);
 }
 
-void Activities::Private::scheduleConfigSync()
+void Activities::Private::recordChange(const QString &activity, int change)
+{
+    QMutexLocker lock(&changesMutex);
+
+    if (pendingChanges.isEmpty()) {
+        // Coalescing everything that happens until the event loop
+        // gets to process the queued call
+        QMetaObject::invokeMethod(this, "flushChanges", Qt::QueuedConnection);
+    }
+
+    pendingChanges[activity] |= change;
+}
+
+void Activities::Private::flushChanges()
 {
-    static const auto shortInterval = 1000;
+    ActivityChangeList changes;
+    quint64 sequence;
+
+    {
+        QMutexLocker lock(&changesMutex);
+
+        if (pendingChanges.isEmpty()) {
+            return;
+        }
+
+        for (auto it = pendingChanges.cbegin(); it != pendingChanges.cend(); ++it) {
+            changes << ActivityChange(it.key(), it.value());
+        }
 
-    // If the timer is not running, or has a longer interval than we need,
-    // start it
-    // Note: If you want to add multiple different delays for different
-    // events based on the importance of how quickly something needs
-    // to be synced to the config, don't. Since the QTimer lives in a
-    // separate thread, we have to communicate with it in via
-    // queued connections, which means that we don't know whether
-    // the timer was already started when this method was invoked,
-    // we do not know whether the interval is properly set etc.
-    if (!configSyncTimer.isActive()) {
-        QMetaObject::invokeMethod(
-            &configSyncTimer, "start", Qt::QueuedConnection,
-            Q_ARG(int, shortInterval));
+        pendingChanges.clear();
+        sequence = ++changesSequence;
     }
+
+    emit q->ActivitiesChanged(changes, sequence);
+}
+
+void Activities::Private::scheduleConfigSync()
+{
+    writer->schedule(storeData());
 }
 
 void Activities::Private::configSync()
 {
-    // Stop the timer and reset the interval to zero
-    QMetaObject::invokeMethod(&configSyncTimer, "stop", Qt::QueuedConnection);
-    config.sync();
+    writer->schedule(storeData());
+    writer->flush();
 }
 
 void Activities::Private::setActivityState(const QString &activity,
@@ -342,10 +478,20 @@ void Activities::Private::setActivityState(const QString &activity,
         configNeedsUpdating = ((activities[activity] & 4) != (state & 4));
 
         activities[activity] = state;
+
+        publishSnapshot();
     }
 
+    invalidateInformation();
+
+    // Only the start that a switch has asked for is a part of it,
+    // the activity might be restarted later without a switch
+    const auto switchId =
+        state == Activities::Starting ? 0 : startingSwitches.take(activity);
+
     switch (state) {
         case Activities::Running:
+            SwitchTrace::mark(switchId, QStringLiteral("running"));
             emit q->ActivityStarted(activity);
             break;
 
@@ -358,18 +504,176 @@ void Activities::Private::setActivityState(const QString &activity,
     }
 
     emit q->ActivityStateChanged(activity, state);
+    recordChange(activity, ActivityChange::State);
 
     if (configNeedsUpdating) {
+        scheduleConfigSync();
+    }
+}
+
+QString Activities::Private::applyChanges(const ActivityChangeMap &changes,
+                                          QVariantMap &created)
+{
+    static const QStringList properties {
+        QStringLiteral("name"),
+        QStringLiteral("description"),
+        QStringLiteral("icon")
+    };
+
+    QStringList added;   // keys of the new activities
+    QStringList removed;
+    QStringList updated;
+
+    // Validating everything before we change anything
+    {
         QReadLocker lock(&activitiesLock);
 
-        mainConfig().writeEntry("runningActivities",
-                                activities.keys(Activities::Running)
-                                + activities.keys(Activities::Starting));
-        mainConfig().writeEntry("stoppedActivities",
-                                activities.keys(Activities::Stopped)
-                                + activities.keys(Activities::Stopping));
-        scheduleConfigSync();
+        for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+            const auto &activity = it.key();
+            const auto &values = it.value();
+
+            for (auto value = values.cbegin(); value != values.cend(); ++value) {
+                if (!properties.contains(value.key())
+                        && value.key() != QLatin1String("remove")) {
+                    return QStringLiteral("Unknown property '%1' for '%2'")
+                               .arg(value.key(), activity);
+                }
+            }
+
+            if (values.value(QStringLiteral("remove")).toBool()) {
+                if (!activities.contains(activity)) {
+                    return QStringLiteral("Can not remove a nonexistent activity '%1'")
+                               .arg(activity);
+                }
+
+                removed << activity;
+
+            } else if (activities.contains(activity)) {
+                updated << activity;
+
+            } else if (values.value(QStringLiteral("name")).toString().isEmpty()) {
+                return QStringLiteral("The new activity '%1' needs a name")
+                           .arg(activity);
+
+            } else {
+                added << activity;
+            }
+        }
+
+        if (activities.size() + added.size() - removed.size() < 1) {
+            return QStringLiteral("Can not remove all activities");
+        }
+    }
+
+    // Stopping the sessions of the activities we are about to remove.
+    // This needs to be done while the activities still exist
+    for (const auto &activity: removed) {
+        q->StopActivity(activity);
     }
+
+    bool currentActivityDeleted = false;
+
+    {
+        QWriteLocker lock(&activitiesLock);
+
+        for (const auto &key: added) {
+            QString activity;
+            while (activity.isEmpty() || activities.contains(activity)) {
+                activity = QUuid::createUuid().toString().mid(1, 36);
+            }
+
+            activities[activity] = Activities::Invalid;
+            created[key] = activity;
+        }
+
+        for (const auto &activity: removed) {
+            activities.remove(activity);
+            metadata.remove(activity);
+            startingSwitches.remove(activity);
+            currentActivityDeleted |= (currentActivity == activity);
+        }
+
+        publishSnapshot();
+    }
+
+    // Starting the new activities the same way addActivity does,
+    // so that the state signals and the bookkeeping are not skipped
+    for (const auto &activity: created) {
+        setActivityState(activity.toString(), Activities::Running);
+    }
+
+    // Updating the names, descriptions and icons, without
+    // notifying anybody until all of them are saved.
+    // In the same order as the properties list
+    static const struct {
+        QString (Private::*get)(const QString &);
+        void (Private::*set)(const QString &, const QString &);
+        int change;
+    } fields[] = {
+        { &Private::activityName,        &Private::setActivityName,        ActivityChange::Name },
+        { &Private::activityDescription, &Private::setActivityDescription, ActivityChange::Description },
+        { &Private::activityIcon,        &Private::setActivityIcon,        ActivityChange::Icon }
+    };
+
+    QHash<QString, int> changed;
+
+    {
+        QWriteLocker lock(&activitiesLock);
+
+        for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+            const auto activity = created.value(it.key(), it.key()).toString();
+
+            if (removed.contains(activity)) {
+                continue;
+            }
+
+            int activityChanges = 0;
+
+            for (int i = 0; i < properties.size(); ++i) {
+                const auto value = it.value().find(properties[i]);
+                if (value == it.value().cend()) continue;
+
+                const auto text = value->toString();
+                if ((this->*fields[i].get)(activity) == text) continue;
+
+                (this->*fields[i].set)(activity, text);
+                activityChanges |= fields[i].change;
+            }
+
+            if (activityChanges && updated.contains(activity)) {
+                changed[activity] = activityChanges;
+            }
+        }
+    }
+
+    invalidateInformation();
+
+    // Saving all the changes at once
+    configSync();
+
+    for (const auto &activity: created) {
+        emit q->ActivityAdded(activity.toString());
+        recordChange(activity.toString(), ActivityChange::Added);
+    }
+
+    for (const auto &activity: removed) {
+        emit q->ActivityRemoved(activity);
+        recordChange(activity, ActivityChange::Removed);
+    }
+
+    for (auto it = changed.cbegin(); it != changed.cend(); ++it) {
+        emit q->ActivityChanged(it.key());
+        recordChange(it.key(), it.value());
+    }
+
+    if (currentActivityDeleted) {
+        ensureCurrentActivityIsRunning();
+
+    } else if (currentActivity.isEmpty() && !created.isEmpty()) {
+        setCurrentActivity(created.first().toString());
+    }
+
+    return QString();
 }
 
 void Activities::Private::ensureCurrentActivityIsRunning()
@@ -434,15 +738,6 @@ Activities::Activities(QObject *parent)
     KDBusConnectionPool::threadConnection().registerObject(
         KAMD_DBUS_OBJECT_PATH(Activities), this);
 
-    // Initializing config
-
-    qCDebug(KAMD_LOG_ACTIVITIES) << "Config timer connecting...";
-    d->connect(&d->configSyncTimer, SIGNAL(timeout()),
-               SLOT(configSync()),
-               Qt::QueuedConnection);
-
-    d->configSyncTimer.setSingleShot(true);
-
     d->ksmserver = new KSMServer(this);
     d->connect(d->ksmserver, SIGNAL(activitySessionStateChanged(QString, int)),
                SLOT(activitySessionStateChanged(QString, int)));
@@ -457,8 +752,7 @@ Activities::~Activities()
 
 QString Activities::CurrentActivity() const
 {
-    QReadLocker lock(&d->activitiesLock);
-    return d->currentActivity;
+    return ActivitiesSnapshot::current()->currentActivity;
 }
 
 bool Activities::SetCurrentActivity(const QString &activity)
@@ -491,39 +785,73 @@ void Activities::RemoveActivity(const QString &activity)
     d->removeActivity(activity);
 }
 
+QVariantMap Activities::ApplyActivityChanges(const ActivityChangeMap &changes)
+{
+    QVariantMap created;
+
+    // We do not care about authorization if this is the first start,
+    // updating the existing activities needs no authorization either
+    const auto snapshot = ActivitiesSnapshot::current();
+    bool addsOrRemoves = false;
+
+    for (auto it = changes.cbegin(); it != changes.cend(); ++it) {
+        if (it.value().value(QStringLiteral("remove")).toBool()
+                || !snapshot->states.contains(it.key())) {
+            addsOrRemoves = true;
+            break;
+        }
+    }
+
+    if (addsOrRemoves && !snapshot->states.isEmpty() &&
+            !KAuthorized::authorize("plasma-desktop/add_activities")) {
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::AccessDenied,
+                           QStringLiteral("Not allowed to add or remove activities"));
+        }
+        return created;
+    }
+
+    const auto error = d->applyChanges(changes, created);
+
+    if (!error.isEmpty()) {
+        qCWarning(KAMD_LOG_ACTIVITIES) << "ApplyActivityChanges:" << error;
+
+        if (calledFromDBus()) {
+            sendErrorReply(QDBusError::InvalidArgs, error);
+        }
+    }
+
+    return created;
+}
+
+qulonglong Activities::ActivitiesChangedSequence() const
+{
+    QMutexLocker lock(&d->changesMutex);
+    return d->changesSequence;
+}
+
 QStringList Activities::ListActivities() const
 {
-    QReadLocker lock(&d->activitiesLock);
-    return d->activities.keys();
+    return ActivitiesSnapshot::current()->activities;
 }
 
 QStringList Activities::ListActivities(int state) const
 {
-    QReadLocker lock(&d->activitiesLock);
-    return d->activities.keys((State)state);
+    return ActivitiesSnapshot::current()->states.keys(state);
 }
 
 QList<ActivityInfo> Activities::ListActivitiesWithInformation() const
 {
-    using namespace kamd::utils;
-
-    // Mapping activity ids to info
-
-    return as_collection<QList<ActivityInfo>>(
-        ListActivities()
-            | transformed(&Activities::ActivityInformation, this)
-    );
+    // The list is shared with the published information, not copied
+    return d->currentInformation()->list;
 }
 
 ActivityInfo Activities::ActivityInformation(const QString &activity) const
 {
-    return ActivityInfo {
-        activity,
-        ActivityName(activity),
-        ActivityDescription(activity),
-        ActivityIcon(activity),
-        ActivityState(activity)
-    };
+    const auto information = d->currentInformation();
+
+    return information->byId.value(activity,
+            ActivityInfo { activity, QString(), QString(), QString(), Invalid });
 }
 
 #define CREATE_GETTER_AND_SETTER(What)                                         \
@@ -545,11 +873,17 @@ ActivityInfo Activities::ActivityInformation(const QString &activity) const
             }                                                                  \
         }                                                                      \
                                                                                \
-        d->activity##What##Config().writeEntry(activity, value);               \
+        {                                                                      \
+            QWriteLocker lock(&d->activitiesLock);                             \
+            d->setActivity##What(activity, value);                             \
+        }                                                                      \
+                                                                               \
+        d->invalidateInformation();                                            \
         d->scheduleConfigSync();                                               \
                                                                                \
         emit Activity##What##Changed(activity, value);                         \
         emit ActivityChanged(activity);                                        \
+        d->recordChange(activity, ActivityChange::What);                       \
     }
 
 CREATE_GETTER_AND_SETTER(Name)
@@ -561,17 +895,28 @@ CREATE_GETTER_AND_SETTER(Icon)
 // Main
 
 void Activities::StartActivity(const QString &activity)
+{
+    d->startActivity(activity);
+}
+
+void Activities::Private::startActivity(const QString &activity,
+                                        quint64 switchId)
 {
     {
-        QReadLocker lock(&d->activitiesLock);
-        if (!d->activities.contains(activity)
-                || d->activities[activity] != Stopped) {
+        QReadLocker lock(&activitiesLock);
+        if (!activities.contains(activity)
+                || activities[activity] != Stopped) {
             return;
         }
     }
 
-    d->setActivityState(activity, Starting);
-    d->ksmserver->startActivitySession(activity);
+    setActivityState(activity, Starting);
+
+    if (switchId) {
+        startingSwitches[activity] = switchId;
+    }
+
+    ksmserver->startActivitySession(activity, switchId);
 }
 
 void Activities::StopActivity(const QString &activity)
@@ -593,7 +938,112 @@ void Activities::StopActivity(const QString &activity)
 
 int Activities::ActivityState(const QString &activity) const
 {
-    QReadLocker lock(&d->activitiesLock);
-    return d->activities.contains(activity) ? d->activities[activity] : Invalid;
+    return ActivitiesSnapshot::current()->state(activity);
+}
+
+bool Activities::isFeatureOperational(const QStringList &feature) const
+{
+    return !feature.isEmpty() && (feature[0] == QLatin1String("switches")
+                                  || feature[0] == QLatin1String("sessions")
+                                  || feature[0] == QLatin1String("persistence"));
 }
 
+QStringList Activities::listFeatures(const QStringList &feature) const
+{
+    if (feature.isEmpty() || feature[0].isEmpty()) {
+        return { QStringLiteral("switches/"), QStringLiteral("sessions/"),
+                 QStringLiteral("persistence/") };
+
+    } else if (feature[0] == QLatin1String("switches")) {
+        return {
+            QStringLiteral("count"),
+            QStringLiteral("latest"),
+            QStringLiteral("histograms")
+        };
+
+    } else if (feature[0] == QLatin1String("sessions")) {
+        return {
+            QStringLiteral("requests"),
+            QStringLiteral("cancelled"),
+            QStringLiteral("completed"),
+            QStringLiteral("timedOut"),
+            QStringLiteral("averageLatency"),
+            QStringLiteral("maxLatency"),
+            QStringLiteral("callsInFlight")
+        };
+
+    } else if (feature[0] == QLatin1String("persistence")) {
+        return {
+            QStringLiteral("scheduled"),
+            QStringLiteral("writes")
+        };
+    }
+
+    return QStringList();
+}
+
+QDBusVariant Activities::featureValue(const QStringList &property) const
+{
+    if (property.size() != 2) {
+        return QDBusVariant();
+    }
+
+    if (property[0] == QLatin1String("sessions")) {
+        const auto statistics = d->ksmserver->statistics();
+
+        if (property[1] == QLatin1String("requests")) {
+            return QDBusVariant((qulonglong)statistics.requests);
+
+        } else if (property[1] == QLatin1String("cancelled")) {
+            return QDBusVariant((qulonglong)statistics.cancelled);
+
+        } else if (property[1] == QLatin1String("completed")) {
+            return QDBusVariant((qulonglong)statistics.completed);
+
+        } else if (property[1] == QLatin1String("timedOut")) {
+            return QDBusVariant((qulonglong)statistics.timedOut);
+
+        } else if (property[1] == QLatin1String("averageLatency")) {
+            return QDBusVariant((qulonglong)(statistics.completed
+                        ? statistics.latency / statistics.completed : 0));
+
+        } else if (property[1] == QLatin1String("maxLatency")) {
+            return QDBusVariant((qulonglong)statistics.maxLatency);
+
+        } else if (property[1] == QLatin1String("callsInFlight")) {
+            return QDBusVariant(statistics.callsInFlight);
+
+        }
+
+        return QDBusVariant();
+    }
+
+    if (property[0] == QLatin1String("persistence")) {
+        if (property[1] == QLatin1String("scheduled")) {
+            return QDBusVariant((qulonglong)d->writer->scheduled());
+
+        } else if (property[1] == QLatin1String("writes")) {
+            return QDBusVariant((qulonglong)d->writer->writes());
+
+        }
+
+        return QDBusVariant();
+    }
+
+    if (property[0] != QLatin1String("switches")) {
+        return QDBusVariant();
+    }
+
+    if (property[1] == QLatin1String("count")) {
+        return QDBusVariant((qulonglong)SwitchTrace::switches());
+
+    } else if (property[1] == QLatin1String("latest")) {
+        return QDBusVariant(SwitchTrace::latest());
+
+    } else if (property[1] == QLatin1String("histograms")) {
+        return QDBusVariant(SwitchTrace::histograms());
+
+    }
+
+    return QDBusVariant();
+}
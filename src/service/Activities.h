@@ -22,6 +22,7 @@
 #define ACTIVITIES_H
 
 // Qt
+#include <QDBusContext>
 #include <QString>
 #include <QStringList>
 
@@ -37,7 +38,7 @@
  * Service for tracking the user actions and managing the
  * activities
  */
-class Activities : public Module {
+class Activities : public Module, protected QDBusContext {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.ActivityManager.Activities")
     Q_PROPERTY(QString CurrentActivity READ CurrentActivity WRITE SetCurrentActivity NOTIFY CurrentActivityChanged)
@@ -65,6 +66,10 @@ public:
      */
     ~Activities() override;
 
+    bool isFeatureOperational(const QStringList &feature) const override;
+    QStringList listFeatures(const QStringList &feature) const override;
+    QDBusVariant featureValue(const QStringList &property) const override;
+
     // workspace activities control
 public Q_SLOTS:
     /**
@@ -109,6 +114,27 @@ public Q_SLOTS:
      */
     void RemoveActivity(const QString &activity);
 
+    /**
+     * Creates, updates and removes multiple activities at once.
+     * The activities are notified about with a single signal each,
+     * and the configuration is saved only once.
+     *
+     * @param changes maps the activities to their changed properties,
+     *     "name", "description" and "icon". An existing activity is
+     *     removed if it has the "remove" property set to true. The keys
+     *     that are not existing activity ids denote new activities,
+     *     which need to have a name.
+     * @returns the ids of the created activities, mapped from the
+     *     keys used for them in the changes
+     * @note If any of the changes is invalid, nothing is changed
+     */
+    QVariantMap ApplyActivityChanges(const ActivityChangeMap &changes);
+
+    /**
+     * @returns the sequence number of the last ActivitiesChanged signal
+     */
+    qulonglong ActivitiesChangedSequence() const;
+
     /**
      * @returns the list of all existing activities
      */
@@ -235,6 +261,16 @@ Q_SIGNALS:
      */
     void ActivityStateChanged(const QString &activity, int state);
 
+    /**
+     * Emitted at most once per event loop iteration with all the
+     * changes since the previous emission, a combination of
+     * ActivityChange::Change values for each changed activity.
+     * The sequence number is increased by one with each emission,
+     * a client that sees a gap has missed some changes and needs
+     * to reload the activities
+     */
+    void ActivitiesChanged(const ActivityChangeList &changes, qulonglong sequence);
+
 private:
     D_PTR;
 };
@@ -0,0 +1,64 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "ActivitiesSnapshot.h"
+
+// STL
+#include <atomic>
+
+
+namespace {
+    std::atomic<quint64> s_version(0);
+
+    ActivitiesSnapshot::Ptr s_snapshot
+        = std::make_shared<const ActivitiesSnapshot>(
+                QString(), QHash<QString, int>(), 0);
+}
+
+ActivitiesSnapshot::ActivitiesSnapshot(const QString &currentActivity,
+                                       const QHash<QString, int> &states,
+                                       quint64 version)
+    : currentActivity(currentActivity)
+    , activities(states.keys())
+    , states(states)
+    , version(version)
+{
+}
+
+int ActivitiesSnapshot::state(const QString &activity) const
+{
+    return states.value(activity, 0);
+}
+
+ActivitiesSnapshot::Ptr ActivitiesSnapshot::current()
+{
+    // Not lock-free for shared_ptr, see the class documentation
+    return std::atomic_load(&s_snapshot);
+}
+
+void ActivitiesSnapshot::publish(const QString &currentActivity,
+                                 const QHash<QString, int> &states)
+{
+    std::atomic_store(&s_snapshot,
+        std::make_shared<const ActivitiesSnapshot>(
+            currentActivity, states, ++s_version));
+}
+
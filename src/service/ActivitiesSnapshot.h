@@ -0,0 +1,85 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTIVITIES_SNAPSHOT_H
+#define ACTIVITIES_SNAPSHOT_H
+
+#include "kactivitymanagerd_plugin_export.h"
+
+// Qt
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// STL
+#include <memory>
+
+
+/**
+ * Immutable view of the activities, published by the Activities
+ * module every time the current activity or the list of activities
+ * changes.
+ *
+ * Reading the snapshot does not go through the Activities object nor
+ * its lock, which makes it suitable for the code that needs the
+ * current activity for every event it processes. It is not lock-free
+ * though, the shared pointer is copied with std::atomic_load, which
+ * takes a short internal lock in the standard library. The lock is
+ * held only while the pointer is copied, never while a snapshot
+ * is being built.
+ */
+class KACTIVITYMANAGERD_PLUGIN_EXPORT ActivitiesSnapshot {
+public:
+    typedef std::shared_ptr<const ActivitiesSnapshot> Ptr;
+
+    ActivitiesSnapshot(const QString &currentActivity,
+                       const QHash<QString, int> &states, quint64 version);
+
+    const QString currentActivity;
+    const QStringList activities;
+
+    // Activities::State values for each of the activities
+    const QHash<QString, int> states;
+
+    /**
+     * @returns the state of the activity, or zero (Invalid)
+     * if the activity does not exist
+     */
+    int state(const QString &activity) const;
+
+    // Increased with every published snapshot
+    const quint64 version;
+
+    /**
+     * @returns the latest published snapshot, never null
+     */
+    static Ptr current();
+
+    /**
+     * Replaces the current snapshot. Meant to be called only
+     * by the module that manages the activities, and it needs
+     * to make sure the calls do not overlap so that a newer
+     * snapshot is never replaced by an older one
+     */
+    static void publish(const QString &currentActivity,
+                        const QHash<QString, int> &states);
+};
+
+#endif // ACTIVITIES_SNAPSHOT_H
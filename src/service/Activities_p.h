@@ -25,13 +25,17 @@
 #include "Activities.h"
 
 // Qt
+#include <QMutex>
 #include <QString>
-#include <QTimer>
 #include <QReadWriteLock>
 
-// KDE
-#include <kconfig.h>
-#include <kconfiggroup.h>
+// STL
+#include <atomic>
+#include <memory>
+
+// Local
+#include "ActivityStore.h"
+#include "ActivityStoreWriter.h"
 
 
 class KSMServer;
@@ -49,6 +53,9 @@ public:
     // the user has used
     void loadLastActivity();
 
+    // Collects the data that the activity store needs to save
+    ActivityStore::Data storeData();
+
     // If the current activity is not running,
     // make some other activity current
     void ensureCurrentActivityIsRunning();
@@ -59,65 +66,127 @@ public Q_SLOTS:
 public:
     void setActivityState(const QString &activity, Activities::State state);
 
+    // Starts the activity if it is stopped. The switch id is passed
+    // when the activity is started because of a switch to it
+    void startActivity(const QString &activity, quint64 switchId = 0);
+
+    // Validates and applies the changes, returns an empty string on
+    // success, or the description of the first invalid change
+    QString applyChanges(const ActivityChangeMap &changes, QVariantMap &created);
+
+    // Adds the change to the next ActivitiesChanged signal,
+    // can be called from any thread
+    void recordChange(const QString &activity, int change);
+
+    // Publishes the current activity and the activity states for
+    // the plugins and for the getters that do not lock. The caller
+    // needs to hold the activitiesLock for writing, which also keeps
+    // the snapshots in order
+    void publishSnapshot();
+
+    // Marks the information about all activities that
+    // ListActivitiesWithInformation returns as outdated. Needs to be
+    // called after every change of the activity list, states or the
+    // activity names, descriptions and icons. The information is
+    // rebuilt only once it is requested, so a batch of changes
+    // does not rebuild it for each of them
+    void invalidateInformation();
+
     // Configuration
     class KDE4ConfigurationTransitionChecker {
     public:
         KDE4ConfigurationTransitionChecker();
     } kde4ConfigurationTransitionChecker;
-    QTimer configSyncTimer;
-    KConfig config;
+    ActivityStore store;
+
+    // Saves the store and the configuration file in the background
+    std::unique_ptr<ActivityStoreWriter> writer;
+
+    // The activity that was current when the service was last running
+    QString lastActivity;
 
     // Interface to the session management
     KSMServer *ksmserver;
 
+    // These are changed only from the thread that owns the module,
+    // with the activitiesLock held for writing. The other threads
+    // should read the ActivitiesSnapshot instead
     QHash<QString, Activities::State> activities;
+
+    // The switches that are waiting for their activity to start,
+    // used only from the thread that owns the module
+    QHash<QString, quint64> startingSwitches;
+    QHash<QString, ActivityStore::Activity> metadata;
     QReadWriteLock activitiesLock;
     QString currentActivity;
 
-public:
-    inline KConfigGroup activityNameConfig()
-    {
-        return KConfigGroup(&config, "activities");
-    }
+    // Immutable, replaced as a whole when it is requested after
+    // a change, so that it can be read without locking the activities.
+    // The pointer itself is loaded and stored with std::atomic_load and
+    // std::atomic_store, which are not lock-free for shared_ptr, they
+    // take a short internal lock while the pointer is copied
+    struct Information {
+        ActivityInfoList list;
+        QHash<QString, ActivityInfo> byId;
+    };
+    std::shared_ptr<const Information> information;
+    std::atomic<bool> informationOutdated { true };
+    QMutex informationMutex;
+
+    // Returns the information, rebuilding it first if it is outdated.
+    // Must not be called with the activitiesLock held
+    std::shared_ptr<const Information> currentInformation();
+
+    // Changes that are waiting for the ActivitiesChanged signal
+    QMutex changesMutex;
+    QHash<QString, int> pendingChanges;
+    quint64 changesSequence;
 
-    inline KConfigGroup activityDescriptionConfig()
+public:
+    // The getters need the activitiesLock, and the setters need
+    // it for writing
+    inline QString activityName(const QString &activity)
     {
-        return KConfigGroup(&config, "activities-descriptions");
+        return metadata.value(activity).name;
     }
 
-    inline KConfigGroup activityIconConfig()
+    inline QString activityDescription(const QString &activity)
     {
-        return KConfigGroup(&config, "activities-icons");
+        return metadata.value(activity).description;
     }
 
-    inline KConfigGroup mainConfig()
+    inline QString activityIcon(const QString &activity)
     {
-        return KConfigGroup(&config, "main");
+        return metadata.value(activity).icon;
     }
 
-    inline QString activityName(const QString &activity)
+    inline void setActivityName(const QString &activity, const QString &value)
     {
-        return activityNameConfig().readEntry(activity, QString());
+        metadata[activity].name = value;
     }
 
-    inline QString activityDescription(const QString &activity)
+    inline void setActivityDescription(const QString &activity, const QString &value)
     {
-        return activityDescriptionConfig().readEntry(activity, QString());
+        metadata[activity].description = value;
     }
 
-    inline QString activityIcon(const QString &activity)
+    inline void setActivityIcon(const QString &activity, const QString &value)
     {
-        return activityIconConfig().readEntry(activity, QString());
+        metadata[activity].icon = value;
     }
 
 public Q_SLOTS:
-    // Schedules config syncing to be done after
-    // a predefined time interval
+    // Schedules saving the activities, it will be done
+    // in the background after the changes settle down
     void scheduleConfigSync();
 
-    // Immediately syncs the configuration file
+    // Saves the activities in the background without
+    // waiting for the changes to settle down
     void configSync();
 
+    // Emits the ActivitiesChanged signal with the pending changes
+    void flushChanges();
+
     QString addActivity(const QString &name);
     void removeActivity(const QString &activity);
     void activitySessionStateChanged(const QString &activity, int state);
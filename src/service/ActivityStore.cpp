@@ -0,0 +1,250 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "ActivityStore.h"
+
+// Qt
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+// KDE
+#include <kconfig.h>
+#include <kconfiggroup.h>
+
+// Local
+#include "DebugActivities.h"
+
+
+namespace {
+    const quint32 magic = 0x4b414d44; // KAMD
+    const quint32 formatVersion = 1;
+
+    // The groups in the configuration file
+    const char *nameGroup = "activities";
+    const char *descriptionGroup = "activities-descriptions";
+    const char *iconGroup = "activities-icons";
+    const char *mainGroup = "main";
+}
+
+ActivityStore::ActivityStore(const QString &fileName)
+    : m_fileName(fileName)
+{
+}
+
+QString ActivityStore::fileName() const
+{
+    return m_fileName;
+}
+
+QString ActivityStore::defaultFileName()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+           + QStringLiteral("/kactivitymanagerd/activities");
+}
+
+QString ActivityStore::configFileName()
+{
+    return QStringLiteral("kactivitymanagerdrc");
+}
+
+KSharedConfig::Ptr ActivityStore::settings()
+{
+    // Keeping the config alive, so that the file
+    // is not parsed again for each of the modules
+    static const auto config
+        = KSharedConfig::openConfig(configFileName());
+
+    return config;
+}
+
+bool ActivityStore::isNewerThanConfig() const
+{
+    const QFileInfo storeInfo(m_fileName);
+    const QFileInfo configInfo(
+        QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+        + '/' + configFileName());
+
+    // If the config file has been changed after the store was saved,
+    // somebody else has written it, and it has the newer data
+    return storeInfo.exists()
+           && (!configInfo.exists()
+               || configInfo.lastModified() <= storeInfo.lastModified());
+}
+
+bool ActivityStore::load(Data &data) const
+{
+    QFile file(m_fileName);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    // Reading everything at once, and parsing from memory
+    const auto contents = file.readAll();
+
+    QDataStream in(contents);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 fileMagic = 0;
+    quint32 fileVersion = 0;
+    in >> fileMagic >> fileVersion;
+
+    if (fileMagic != magic || fileVersion != formatVersion) {
+        qCWarning(KAMD_LOG_ACTIVITIES) << "The activity store has an unknown format:"
+                                       << m_fileName;
+        return false;
+    }
+
+    Data result;
+    quint32 count = 0;
+    in >> result.currentActivity >> result.stoppedActivities >> count;
+
+    result.activities.reserve(count);
+
+    for (quint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QString id;
+        Activity activity;
+        in >> id >> activity.name >> activity.description >> activity.icon;
+        result.activities[id] = activity;
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qCWarning(KAMD_LOG_ACTIVITIES) << "The activity store is corrupted:"
+                                       << m_fileName;
+        return false;
+    }
+
+    data = result;
+    return true;
+}
+
+bool ActivityStore::save(const Data &data) const
+{
+    QByteArray contents;
+
+    {
+        QDataStream out(&contents, QIODevice::WriteOnly);
+        out.setVersion(QDataStream::Qt_5_6);
+
+        out << magic << formatVersion
+            << data.currentActivity << data.stoppedActivities
+            << (quint32)data.activities.size();
+
+        for (auto it = data.activities.cbegin(); it != data.activities.cend(); ++it) {
+            out << it.key() << it->name << it->description << it->icon;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(m_fileName).absolutePath());
+
+    // QSaveFile writes into a temporary file, and
+    // replaces the old store only if everything succeeded
+    QSaveFile file(m_fileName);
+
+    if (!file.open(QIODevice::WriteOnly)
+            || file.write(contents) != contents.size()
+            || !file.commit()) {
+        qCWarning(KAMD_LOG_ACTIVITIES) << "Can not save the activity store:"
+                                       << m_fileName << file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void ActivityStore::importConfig(KConfig &config, Data &data)
+{
+    const KConfigGroup main(&config, mainGroup);
+    const KConfigGroup names(&config, nameGroup);
+    const KConfigGroup descriptions(&config, descriptionGroup);
+    const KConfigGroup icons(&config, iconGroup);
+
+    // Saving only the running activities means that if we have any
+    // errors in the config, we might end up with all activities
+    // stopped
+
+    const bool stoppedByDefault
+        = main.hasKey("runningActivities") && !main.hasKey("stoppedActivities");
+
+    const auto runningActivities
+        = main.readEntry("runningActivities", QStringList()).toSet();
+    const auto stoppedActivities
+        = main.readEntry("stoppedActivities", QStringList()).toSet();
+
+    for (const auto &activity: names.keyList()) {
+        const bool stopped =
+            runningActivities.contains(activity) ? false :
+            stoppedActivities.contains(activity) ? true :
+                                                   stoppedByDefault;
+
+        if (stopped) {
+            data.stoppedActivities << activity;
+        }
+
+        data.activities[activity] = Activity {
+            names.readEntry(activity, QString()),
+            descriptions.readEntry(activity, QString()),
+            icons.readEntry(activity, QString())
+        };
+    }
+
+    data.currentActivity = main.readEntry("currentActivity", QString());
+}
+
+void ActivityStore::exportConfig(KConfig &config, const Data &data)
+{
+    KConfigGroup main(&config, mainGroup);
+    KConfigGroup names(&config, nameGroup);
+    KConfigGroup descriptions(&config, descriptionGroup);
+    KConfigGroup icons(&config, iconGroup);
+
+    // KConfig marks the file as changed only if the values
+    // are different from the ones it already has
+    for (auto group: { &names, &descriptions, &icons }) {
+        for (const auto &activity: group->keyList()) {
+            if (!data.activities.contains(activity)) {
+                group->deleteEntry(activity);
+            }
+        }
+    }
+
+    QStringList runningActivities;
+
+    for (auto it = data.activities.cbegin(); it != data.activities.cend(); ++it) {
+        names.writeEntry(it.key(), it->name);
+        descriptions.writeEntry(it.key(), it->description);
+        icons.writeEntry(it.key(), it->icon);
+
+        if (!data.stoppedActivities.contains(it.key())) {
+            runningActivities << it.key();
+        }
+    }
+
+    main.writeEntry("runningActivities", runningActivities);
+    main.writeEntry("stoppedActivities", data.stoppedActivities);
+    main.writeEntry("currentActivity", data.currentActivity);
+
+    config.sync();
+}
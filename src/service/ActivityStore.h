@@ -0,0 +1,95 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTIVITY_STORE_H
+#define ACTIVITY_STORE_H
+
+// Qt
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+// KDE
+#include <ksharedconfig.h>
+
+class KConfig;
+
+/**
+ * Compact binary file with the activities and their properties.
+ * It is read in one go at startup, which is much faster than parsing
+ * the configuration file when there are many activities. The
+ * configuration file is still kept up-to-date for compatibility,
+ * it can be imported from and exported to.
+ */
+class ActivityStore {
+public:
+    struct Activity {
+        QString name;
+        QString description;
+        QString icon;
+    };
+
+    struct Data {
+        QHash<QString, Activity> activities;
+        QStringList stoppedActivities;
+        QString currentActivity;
+    };
+
+    explicit ActivityStore(const QString &fileName = defaultFileName());
+
+    QString fileName() const;
+
+    /**
+     * Reads the whole store
+     * @returns false if the file does not exist or is not valid
+     */
+    bool load(Data &data) const;
+
+    /**
+     * Atomically replaces the store with the new data
+     */
+    bool save(const Data &data) const;
+
+    /**
+     * @returns whether the store exists and has not been
+     * outdated by a newer configuration file
+     */
+    bool isNewerThanConfig() const;
+
+    static QString defaultFileName();
+
+    // kactivitymanagerdrc
+    static QString configFileName();
+
+    static void importConfig(KConfig &config, Data &data);
+    static void exportConfig(KConfig &config, const Data &data);
+
+    /**
+     * The configuration file, opened once and shared by the modules
+     * that read their settings from it on startup. Meant to be used
+     * only from the main thread
+     */
+    static KSharedConfig::Ptr settings();
+
+private:
+    const QString m_fileName;
+};
+
+#endif // ACTIVITY_STORE_H
@@ -0,0 +1,176 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "ActivityStoreWriter.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+// KDE
+#include <kconfig.h>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// STL
+#include <atomic>
+#include <memory>
+
+
+class ActivityStoreWriter::Private : public QThread {
+public:
+    Private(const ActivityStore &store, int quietPeriod, int maximumDelay)
+        : store(store)
+        , quietPeriod(quietPeriod)
+        , maximumDelay(qMax(quietPeriod, maximumDelay))
+        , hasPending(false)
+        , flushRequested(false)
+        , quit(false)
+        , scheduled(0)
+        , writes(0)
+    {
+    }
+
+    void run() override
+    {
+        forever {
+            ActivityStore::Data data;
+
+            {
+                QMutexLocker lock(&mutex);
+
+                while (!hasPending && !quit) {
+                    condition.wait(&mutex);
+                }
+
+                if (!hasPending) break;
+
+                // Waiting for the changes to settle down,
+                // but not for longer than the maximum delay
+                while (!quit && !flushRequested) {
+                    const auto remaining = qMin(
+                        quietPeriod - lastScheduled.elapsed(),
+                        maximumDelay - firstScheduled.elapsed());
+
+                    if (remaining <= 0) break;
+
+                    condition.wait(&mutex, (unsigned long)remaining);
+                }
+
+                data = pending;
+                pending = ActivityStore::Data();
+                hasPending = false;
+                flushRequested = false;
+            }
+
+            // The config file is written first, so that
+            // the store is not considered outdated
+            if (!config) {
+                config.reset(new KConfig(ActivityStore::configFileName()));
+            }
+
+            ActivityStore::exportConfig(*config, data);
+            store.save(data);
+
+            ++writes;
+        }
+
+        // The config needs to be destroyed in the thread that used it
+        config.reset();
+    }
+
+    const ActivityStore store;
+    const qint64 quietPeriod;
+    const qint64 maximumDelay;
+
+    QMutex mutex;
+    QWaitCondition condition;
+    ActivityStore::Data pending;
+    bool hasPending;
+    bool flushRequested;
+    bool quit;
+    QElapsedTimer firstScheduled;
+    QElapsedTimer lastScheduled;
+
+    std::atomic<quint64> scheduled;
+    std::atomic<quint64> writes;
+
+    // Used only from the writer thread
+    std::unique_ptr<KConfig> config;
+};
+
+ActivityStoreWriter::ActivityStoreWriter(const ActivityStore &store,
+                                         int quietPeriod, int maximumDelay)
+    : d(store, quietPeriod, maximumDelay)
+{
+    d->start(QThread::LowPriority);
+}
+
+ActivityStoreWriter::~ActivityStoreWriter()
+{
+    {
+        QMutexLocker lock(&d->mutex);
+        d->quit = true;
+        d->condition.wakeAll();
+    }
+
+    d->wait();
+}
+
+void ActivityStoreWriter::schedule(const ActivityStore::Data &data)
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (!d->hasPending) {
+        d->firstScheduled.start();
+    }
+
+    d->lastScheduled.start();
+    d->pending = data;
+    d->hasPending = true;
+    ++d->scheduled;
+
+    d->condition.wakeAll();
+}
+
+void ActivityStoreWriter::flush()
+{
+    QMutexLocker lock(&d->mutex);
+
+    if (d->hasPending) {
+        d->flushRequested = true;
+        d->condition.wakeAll();
+    }
+}
+
+quint64 ActivityStoreWriter::scheduled() const
+{
+    return d->scheduled;
+}
+
+quint64 ActivityStoreWriter::writes() const
+{
+    return d->writes;
+}
@@ -0,0 +1,66 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ACTIVITY_STORE_WRITER_H
+#define ACTIVITY_STORE_WRITER_H
+
+// Utils
+#include <utils/d_ptr.h>
+
+// Local
+#include "ActivityStore.h"
+
+
+/**
+ * Saves the activity store and exports the configuration file in
+ * a separate thread, so that the disk writes do not block the
+ * Activities module.
+ *
+ * The writes are debounced. The data is saved when nothing has been
+ * scheduled for the quiet period, or when the maximum delay since the
+ * first unsaved change has passed, whichever comes first. Only the
+ * latest scheduled data is saved.
+ */
+class ActivityStoreWriter {
+public:
+    ActivityStoreWriter(const ActivityStore &store,
+                        int quietPeriod, int maximumDelay); // ms
+
+    /**
+     * Saves the pending data before returning
+     */
+    ~ActivityStoreWriter();
+
+    void schedule(const ActivityStore::Data &data);
+
+    /**
+     * Saves the pending data without waiting for the quiet period,
+     * does not wait for the data to be saved
+     */
+    void flush();
+
+    quint64 scheduled() const;
+    quint64 writes() const;
+
+private:
+    D_PTR;
+};
+
+#endif // ACTIVITY_STORE_WRITER_H
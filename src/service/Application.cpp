@@ -29,6 +29,11 @@
 #include <QDBusServiceWatcher>
 #include <QDBusConnectionInterface>
 #include <QDBusReply>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QMetaMethod>
+#include <QPluginLoader>
+#include <QTimer>
 
 // KDE
 // #include <KCrash>
@@ -48,21 +53,40 @@
 // System
 #include <signal.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <memory>
 #include <functional>
 
 // Local
 #include "Activities.h"
+#include "ActivityStore.h"
 #include "Resources.h"
 #include "Features.h"
 #include "Config.h"
 #include "Plugin.h"
+#include "Replay.h"
+#include "StartupProfiler.h"
 #include "DebugApplication.h"
 #include "common/dbus/common.h"
 
 
 namespace {
     QList<QThread *> s_moduleThreads;
+
+    // Resident memory of the process in KiB, or -1 if it is not known
+    qint64 residentMemory()
+    {
+        QFile statm(QStringLiteral("/proc/self/statm"));
+
+        if (!statm.open(QIODevice::ReadOnly)) {
+            return -1;
+        }
+
+        const auto fields = statm.readAll().split(' ');
+
+        return fields.size() < 2 ? -1
+             : fields[1].toLongLong() * sysconf(_SC_PAGESIZE) / 1024;
+    }
 }
 
 // Runs a QObject inside a QThread
@@ -102,6 +126,7 @@ T *runInQThread()
 class Application::Private {
 public:
     Private()
+        : ready(false)
     {
     }
 
@@ -121,6 +146,61 @@ public:
 
     bool loadPlugin(const KPluginMetaData& plugin);
 
+    // Finds the enabled plugins, and separates the ones that need to be
+    // loaded on startup from the ones that are loaded on first use
+    void findPlugins();
+
+    // Plugins can declare when they need to be loaded with
+    // X-KActivityManager-ActivateOn in their metadata:
+    //  - signal:module/Signal  - a signal emitted by one of the modules,
+    //                            the plugin is loaded after the emission
+    //                            so it needs to catch up with it in init
+    //  - idle                  - after the service becomes ready
+    // Plugins without triggers, and the SQLite one which is needed
+    // for the proper workspace behaviour, are loaded on startup.
+    // Plugins that export D-Bus objects need to be loaded on startup
+    // as well, the calls need to reach them from their real senders.
+    QHash<QString, KPluginMetaData> lazyPlugins;
+    QMultiHash<QString, QString> triggers;
+    QStringList deferredPlugins;
+
+    QMultiHash<QString, QMetaObject::Connection> signalConnections;
+
+    void addTriggers(Application *application);
+    void removeTrigger(const QString &trigger);
+    bool activate(const QString &pluginId, const QString &trigger);
+
+    // Loads the plugin libraries in a separate thread, so that the
+    // dynamic linking is done while the modules are being created.
+    // The plugins are instantiated later, in the main thread
+    class Preloader : public QThread {
+    public:
+        Preloader(const QVector<KPluginMetaData> &plugins)
+            : plugins(plugins)
+        {
+        }
+
+        void run() override
+        {
+            for (const auto &plugin: plugins) {
+                StartupProfiler::Phase phase(
+                    QStringLiteral("plugin/%1/preload").arg(plugin.pluginId()));
+
+                QPluginLoader loader(plugin.fileName());
+                if (!loader.load()) {
+                    qCWarning(KAMD_LOG_APPLICATION) << "[ FAILED ] preloading:"
+                            << plugin.pluginId() << loader.errorString();
+                }
+            }
+        }
+
+    private:
+        const QVector<KPluginMetaData> plugins;
+    };
+
+    QVector<KPluginMetaData> offers;
+    std::unique_ptr<Preloader> preloader;
+
     Resources *resources;
     Activities *activities;
     Features *features;
@@ -128,6 +208,9 @@ public:
     QStringList pluginIds;
     QList<Plugin *> plugins;
 
+    // Set when the startup plugins are loaded
+    bool ready;
+
     static Application *s_instance;
 };
 
@@ -140,18 +223,43 @@ Application::Application(int &argc, char **argv)
 
 void Application::init()
 {
-    if (!KDBusConnectionPool::threadConnection().registerService(
-            KAMD_DBUS_SERVICE)) {
-        QCoreApplication::exit(EXIT_SUCCESS);
+    {
+        StartupProfiler::Phase phase(QStringLiteral("dbus-registration"));
+
+        if (!KDBusConnectionPool::threadConnection().registerService(
+                KAMD_DBUS_SERVICE)) {
+            QCoreApplication::exit(EXIT_SUCCESS);
+        }
+    }
+
+    {
+        StartupProfiler::Phase phase(QStringLiteral("plugins/discovery"));
+        d->findPlugins();
     }
 
+    d->preloader.reset(new Private::Preloader(d->offers));
+    d->preloader->start();
+
+    // The modules register their D-Bus objects on the main thread's
+    // connection and into the module list, so they are created one
+    // after another, while the plugins are being loaded
+
     // KAMD is a daemon, if it crashes it is not a problem as
     // long as it restarts properly
     // TODO: Restart on crash
     //       KCrash::setFlags(KCrash::AutoRestart);
-    d->resources  = runInQThread<Resources>();
-    d->activities = runInQThread<Activities>();
-    d->features   = runInQThread<Features>();
+    {
+        StartupProfiler::Phase phase(QStringLiteral("module/resources"));
+        d->resources  = runInQThread<Resources>();
+    }
+    {
+        StartupProfiler::Phase phase(QStringLiteral("module/activities"));
+        d->activities = runInQThread<Activities>();
+    }
+    {
+        StartupProfiler::Phase phase(QStringLiteral("module/features"));
+        d->features   = runInQThread<Features>();
+    }
     /* d->config */ new Config(this); // this does not need a separate thread
 
     QMetaObject::invokeMethod(this, "loadPlugins", Qt::QueuedConnection);
@@ -173,18 +281,28 @@ bool Application::Private::loadPlugin(const KPluginMetaData& plugin)
     }
 
     KPluginLoader loader(plugin.fileName());
-    KPluginFactory* factory = loader.factory();
-    if (!factory) {
-        qCWarning(KAMD_LOG_APPLICATION) << "[ FAILED ] Could not load KPluginFactory for:"
-                << plugin.pluginId() << loader.errorString();
-        return false;
-    }
+    Plugin *pluginInstance = nullptr;
+
+    {
+        StartupProfiler::Phase phase(
+            QStringLiteral("plugin/%1/load").arg(plugin.pluginId()));
 
-    auto pluginInstance = factory->create<Plugin>();
+        KPluginFactory* factory = loader.factory();
+        if (!factory) {
+            qCWarning(KAMD_LOG_APPLICATION) << "[ FAILED ] Could not load KPluginFactory for:"
+                    << plugin.pluginId() << loader.errorString();
+            return false;
+        }
+
+        pluginInstance = factory->create<Plugin>();
+    }
 
     auto &modules = Module::get();
 
     if (pluginInstance) {
+        StartupProfiler::Phase phase(
+            QStringLiteral("plugin/%1/init").arg(plugin.pluginId()));
+
         bool success = pluginInstance->init(modules);
 
         if (success) {
@@ -207,24 +325,201 @@ bool Application::Private::loadPlugin(const KPluginMetaData& plugin)
     }
 }
 
-void Application::loadPlugins()
+void Application::Private::findPlugins()
 {
     using namespace std::placeholders;
 
     const auto config
-        = KSharedConfig::openConfig(QStringLiteral("kactivitymanagerdrc"))
-              ->group("Plugins");
-    const auto offers = KPluginLoader::findPlugins(QStringLiteral(KAMD_PLUGIN_DIR),
+        = ActivityStore::settings()->group("Plugins");
+    const auto enabled = KPluginLoader::findPlugins(QStringLiteral(KAMD_PLUGIN_DIR),
         std::bind(Private::isPluginEnabled, config, _1));
-    qCDebug(KAMD_LOG_APPLICATION) << "Found" << offers.size() << "enabled plugins:";
+    qCDebug(KAMD_LOG_APPLICATION) << "Found" << enabled.size() << "enabled plugins:";
+
+    const bool lazyActivation = config.readEntry("LazyActivation", true);
+
+    for (const auto &plugin: enabled) {
+        const auto pluginTriggers = plugin.rawData()
+            .value(QStringLiteral("X-KActivityManager-ActivateOn"))
+            .toVariant().toStringList();
+
+        if (!lazyActivation || pluginTriggers.isEmpty()
+                || plugin.pluginId() == "org.kde.ActivityManager.ResourceScoring") {
+            offers << plugin;
+            continue;
+        }
+
+        lazyPlugins[plugin.pluginId()] = plugin;
+
+        for (const auto &trigger: pluginTriggers) {
+            if (trigger == QLatin1String("idle")) {
+                deferredPlugins << plugin.pluginId();
+            } else {
+                triggers.insert(trigger, plugin.pluginId());
+            }
+        }
+    }
+
+    qCDebug(KAMD_LOG_APPLICATION) << "Loading on startup:" << offers.size()
+                                  << "on first use:" << lazyPlugins.keys();
+}
+
+void Application::Private::addTriggers(Application *application)
+{
+    const auto slot = application->metaObject()->method(
+        application->metaObject()->indexOfSlot("activatePluginsOnSignal()"));
+
+    for (const auto &trigger: triggers.uniqueKeys()) {
+        const auto kind = trigger.section(QLatin1Char(':'), 0, 0);
+        const auto target = trigger.section(QLatin1Char(':'), 1);
+
+        if (kind == QLatin1String("signal")) {
+            const auto module = Module::get(target.section(QLatin1Char('/'), 0, 0));
+            const auto signal = target.section(QLatin1Char('/'), 1).toLatin1();
+
+            if (!module) {
+                qCWarning(KAMD_LOG_APPLICATION) << "Unknown module in" << trigger;
+                continue;
+            }
+
+            const auto metaObject = module->metaObject();
+
+            for (int i = 0; i < metaObject->methodCount(); ++i) {
+                const auto method = metaObject->method(i);
+
+                if (method.methodType() == QMetaMethod::Signal
+                        && method.name() == signal) {
+                    signalConnections.insert(trigger,
+                        QObject::connect(module, method, application, slot,
+                                         Qt::QueuedConnection));
+                }
+            }
+
+        } else {
+            qCWarning(KAMD_LOG_APPLICATION) << "Unknown plugin activation trigger" << trigger;
+        }
+    }
+}
+
+void Application::Private::removeTrigger(const QString &trigger)
+{
+    for (const auto &connection: signalConnections.values(trigger)) {
+        QObject::disconnect(connection);
+    }
+    signalConnections.remove(trigger);
+}
+
+bool Application::Private::activate(const QString &pluginId, const QString &trigger)
+{
+    if (!lazyPlugins.contains(pluginId)) {
+        return pluginIds.contains(pluginId);
+    }
+
+    const auto plugin = lazyPlugins.take(pluginId);
+
+    for (const auto &pluginTrigger: triggers.keys(pluginId)) {
+        triggers.remove(pluginTrigger, pluginId);
+
+        if (!triggers.contains(pluginTrigger)) {
+            removeTrigger(pluginTrigger);
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const bool result = loadPlugin(plugin);
+
+    qCDebug(KAMD_LOG_APPLICATION) << "Activated" << pluginId << "on" << trigger
+                                  << "in" << timer.elapsed() << "ms";
+
+    return result;
+}
+
+void Application::loadPlugins()
+{
+    {
+        StartupProfiler::Phase phase(QStringLiteral("plugins/preload-wait"));
+        d->preloader->wait();
+    }
 
-    for (const auto &offer : offers) {
+    for (const auto &offer : d->offers) {
         d->loadPlugin(offer);
     }
+
+    d->addTriggers(this);
+
+    // The service is ready, the rest of the plugins
+    // are loaded when they are needed
+    StartupProfiler::counter(QStringLiteral("memory/resident-at-ready"),
+                             residentMemory());
+    StartupProfiler::finish();
+    d->ready = true;
+
+    qCDebug(KAMD_LOG_APPLICATION) << "Startup phases:" << StartupProfiler::phases();
+
+    // Saving the trace if the user asked for it
+    const auto traceFile = qgetenv("KAMD_STARTUP_TRACE");
+
+    if (!traceFile.isEmpty()) {
+        QFile file(QString::fromLocal8Bit(traceFile));
+
+        if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            file.write(StartupProfiler::chromeTrace());
+        } else {
+            qCWarning(KAMD_LOG_APPLICATION) << "Can not write the startup trace to"
+                                            << file.fileName();
+        }
+    }
+
+    QMetaObject::invokeMethod(this, "loadDeferredPlugins", Qt::QueuedConnection);
+}
+
+void Application::loadDeferredPlugins()
+{
+    // Loading one plugin per event loop iteration, so that
+    // the requests are not waiting for all of them
+    if (!d->deferredPlugins.isEmpty()) {
+        d->activate(d->deferredPlugins.takeFirst(), QStringLiteral("idle"));
+        QMetaObject::invokeMethod(this, "loadDeferredPlugins", Qt::QueuedConnection);
+        return;
+    }
+
+    const auto memory = residentMemory();
+
+    StartupProfiler::counter(QStringLiteral("memory/resident-at-idle"), memory);
+
+    qCDebug(KAMD_LOG_APPLICATION) << "Resident memory at idle:" << memory << "KiB";
+}
+
+bool Application::activatePlugins(const QString &trigger)
+{
+    bool result = false;
+
+    for (const auto &pluginId: d->triggers.values(trigger)) {
+        result = d->activate(pluginId, trigger) || result;
+    }
+
+    return result;
+}
+
+void Application::activatePluginsOnSignal()
+{
+    const auto module = sender();
+
+    if (!module) return;
+
+    const auto signal = module->metaObject()->method(senderSignalIndex());
+
+    activatePlugins(QStringLiteral("signal:%1/%2").arg(
+        Module::get().key(module), QString::fromLatin1(signal.name())));
 }
 
 bool Application::loadPlugin(const QString &pluginId)
 {
+    if (d->lazyPlugins.contains(pluginId)) {
+        return d->activate(pluginId, QStringLiteral("request"));
+    }
+
     auto offers = KPluginLoader::findPluginsById(QStringLiteral(KAMD_PLUGIN_DIR), pluginId);
 
     if (offers.isEmpty()) {
@@ -239,6 +534,11 @@ Application::~Application()
 {
     qCDebug(KAMD_LOG_APPLICATION) << "Cleaning up...";
 
+    // The plugin libraries might still be loading
+    if (d->preloader) {
+        d->preloader->wait();
+    }
+
     // Waiting for the threads to finish
     for (const auto thread : s_moduleThreads) {
         thread->quit();
@@ -290,9 +590,22 @@ QString Application::serviceVersion() const
     return KACTIVITIES_VERSION_STRING;
 }
 
+bool Application::isReady() const
+{
+    return d->ready;
+}
+
+QString Application::startupTrace() const
+{
+    return QString::fromUtf8(StartupProfiler::chromeTrace());
+}
+
 // Leaving object oriented world :)
 
 namespace  {
+    // How long the start command waits for the service to become ready, in ms
+    const int startupTimeout = 30000;
+
     template <typename Return>
     Return callOnRunningService(const QString &method)
     {
@@ -308,11 +621,45 @@ namespace  {
         return callOnRunningService<QString>("serviceVersion");
     }
 
+    bool isRunningServiceReady()
+    {
+        return callOnRunningService<bool>("isReady");
+    }
+
     bool isServiceRunning()
     {
         return QDBusConnection::sessionBus().interface()->isServiceRegistered(
                 KAMD_DBUS_SERVICE);
     }
+
+    QStringList runningServiceFeature(const QString &feature)
+    {
+        QDBusInterface features(KAMD_DBUS_SERVICE,
+                                KAMD_DBUS_OBJECT_PATH(Features),
+                                KAMD_DBUS_OBJECT(Features));
+        QDBusReply<QDBusVariant> reply
+            = features.call(QStringLiteral("GetValue"), feature);
+
+        return reply.isValid() ? reply.value().variant().toStringList()
+                               : QStringList();
+    }
+
+    void printRunningServiceStats()
+    {
+        QTextStream out(stdout);
+
+        out << "Latest activity switches:\n";
+        for (const auto &line: runningServiceFeature(
+                 QStringLiteral("activities/switches/latest"))) {
+            out << "  " << line << '\n';
+        }
+
+        out << "Time from the switch request to the end of each stage:\n";
+        for (const auto &line: runningServiceFeature(
+                 QStringLiteral("activities/switches/histograms"))) {
+            out << "  " << line << '\n';
+        }
+    }
 }
 
 int main(int argc, char **argv)
@@ -339,13 +686,21 @@ int main(int argc, char **argv)
     if (arguments.size() == 0) {
         QCoreApplication::exit(EXIT_FAILURE);
 
+    } else if (arguments.size() >= 3 && arguments[1] == "replay") {
+        // Replaying a recorded event journal against a scratch database
+        return replayJournal(application, arguments[2],
+                             arguments.contains(QStringLiteral("--fast")));
+
     } else if (arguments.size() != 1 && (arguments.size() != 2 || arguments[1] == "--help")) {
 
         QTextStream(stdout)
             << "start\tStarts the service\n"
             << "stop\tStops the server\n"
             << "status\tPrints basic server information\n"
+            << "stats\tPrints the activity switch latencies of the running service\n"
+            << "startup-trace\tPrints the startup phases of the running service as a Chrome trace\n"
             << "start-daemon\tStarts the service without forking (use with caution)\n"
+            << "replay <journal> [--fast]\tReplays the recorded events against a scratch database\n"
             << "--help\tThis help message\n";
 
         QCoreApplication::exit(EXIT_SUCCESS);
@@ -364,17 +719,55 @@ int main(int argc, char **argv)
                                     QDBusConnection::sessionBus(),
                                     QDBusServiceWatcher::WatchForRegistration);
 
-        QObject::connect(&watcher, &QDBusServiceWatcher::serviceRegistered,
-            [] (const QString &service) {
+        // Measuring how long it takes for the service to become ready.
+        // It answers the calls before it loads the plugins, so the
+        // readiness is polled until it is done
+        QElapsedTimer startup;
+        QTimer readyPoll;
+        readyPoll.setInterval(10);
+
+        // Giving up if the service does not register itself or
+        // does not load its plugins in a reasonable time
+        QTimer deadline;
+        deadline.setSingleShot(true);
+        deadline.setInterval(startupTimeout);
+
+        QObject::connect(&deadline, &QTimer::timeout,
+            [&readyPoll] {
+                readyPoll.stop();
+
+                QTextStream(stderr)
+                    << "The service did not become ready in "
+                    << startupTimeout / 1000 << "s\n";
+
+                QCoreApplication::exit(EXIT_FAILURE);
+            });
+
+        QObject::connect(&readyPoll, &QTimer::timeout,
+            [&startup, &readyPoll, &deadline] {
+                if (!isRunningServiceReady()) return;
+
+                readyPoll.stop();
+                deadline.stop();
+
                 QTextStream(stdout)
                     << "Service started, version: " << runningServiceVersion()
+                    << " (ready after " << startup.elapsed() << "ms)"
                     << "\n";
 
                 QCoreApplication::exit(EXIT_SUCCESS);
             });
 
+        QObject::connect(&watcher, &QDBusServiceWatcher::serviceRegistered,
+            [&readyPoll] (const QString &service) {
+                Q_UNUSED(service);
+                readyPoll.start();
+            });
+
         // Starting the dameon
 
+        startup.start();
+        deadline.start();
         QProcess::startDetached(
                 KAMD_FULL_BIN_DIR "/kactivitymanagerd",
                 QStringList{"start-daemon"}
@@ -407,6 +800,28 @@ int main(int argc, char **argv)
 
         return EXIT_SUCCESS;
 
+    } else if (arguments[1] == "stats") {
+
+        if (!isServiceRunning()) {
+            QTextStream(stdout) << "The service is not running\n";
+            return EXIT_FAILURE;
+        }
+
+        printRunningServiceStats();
+
+        return EXIT_SUCCESS;
+
+    } else if (arguments[1] == "startup-trace") {
+
+        if (!isServiceRunning()) {
+            QTextStream(stdout) << "The service is not running\n";
+            return EXIT_FAILURE;
+        }
+
+        QTextStream(stdout) << callOnRunningService<QString>("startupTrace") << '\n';
+
+        return EXIT_SUCCESS;
+
     } else if (arguments[1] == "start-daemon") {
         // Really starting the activity manager
 
@@ -59,9 +59,29 @@ public Q_SLOTS:
     QString serviceVersion() const;
     bool loadPlugin(const QString &plugin);
 
+    /**
+     * @returns whether the startup plugins have been loaded.
+     * The service can answer calls before that
+     */
+    bool isReady() const;
+
+    /**
+     * @returns the durations of the startup phases
+     * in the Chrome trace event format
+     */
+    QString startupTrace() const;
+
 private Q_SLOTS:
     void init();
     void loadPlugins();
+    void loadDeferredPlugins();
+
+    /**
+     * Loads the plugins that declared the specified activation trigger
+     * @returns whether any plugin has been loaded
+     */
+    bool activatePlugins(const QString &trigger);
+    void activatePluginsOnSignal();
 
 private:
     D_PTR;
@@ -23,12 +23,14 @@
 
 // Local
 #include <QDebug>
+#include "ActivitiesSnapshot.h"
 
 
 Event::Event()
     : wid(0)
     , type(Accessed)
     , timestamp(QDateTime::currentDateTime())
+    , repeatCount(1)
 {
 }
 
@@ -38,6 +40,8 @@ Event::Event(const QString &vApplication, quintptr vWid, const QString &vUri, in
     , uri(vUri)
     , type(vType)
     , timestamp(QDateTime::currentDateTime())
+    , repeatCount(1)
+    , activity(ActivitiesSnapshot::current()->currentActivity)
 {
     Q_ASSERT(!vApplication.isEmpty());
     Q_ASSERT(!vUri.isEmpty());
@@ -70,6 +70,8 @@ public:
     QString uri;
     int type;
     QDateTime timestamp;
+    int repeatCount; ///< how many times the event was repeated in the coalescing window
+    QString activity; ///< activity that was current when the event was registered
 
     QString typeName() const;
 };
@@ -0,0 +1,340 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "EventJournal.h"
+
+// Qt
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStandardPaths>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// System
+#include <string.h>
+
+// Local
+#include "DebugResources.h"
+
+
+namespace {
+    const char journalMagic[8] = { 'K', 'A', 'M', 'D', 'J', 'R', 'N', 'L' };
+    const quint32 journalVersion = 4;
+
+    // The header is padded so that the records start at a round offset
+    const qint64 headerSize = 64;
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 headerSize;
+        quint64 capacity;
+        quint64 head;  ///< offset of the oldest record
+        quint64 tail;  ///< offset where the next record will be written
+        quint64 count; ///< number of records in the ring
+    };
+
+    // Followed by the application name, the uri and the activity, in UTF-8.
+    // A record of size 0 marks the end of the current lap
+    struct RecordHeader {
+        quint32 size;
+        quint32 type;
+        qint64 timestamp;
+        qint64 recorded;
+        quint64 wid;
+        quint32 repeatCount;
+        quint32 applicationSize;
+        quint32 uriSize;
+        quint32 activitySize;
+    };
+
+    inline quint32 recordSizeAt(const uchar *data, quint64 capacity,
+                                quint64 offset)
+    {
+        quint32 size = 0;
+
+        if (offset + sizeof(size) <= capacity) {
+            memcpy(&size, data + offset, sizeof(size));
+        }
+
+        return size;
+    }
+
+    inline bool isValidHeader(const Header &header, qint64 fileSize)
+    {
+        return memcmp(header.magic, journalMagic, sizeof(journalMagic)) == 0
+               && header.version == journalVersion
+               && header.headerSize == headerSize
+               && (qint64)header.capacity == fileSize - headerSize
+               && header.head < header.capacity
+               && header.tail <= header.capacity;
+    }
+}
+
+class EventJournal::Private {
+public:
+    Private(const QString &path, qint64 capacity)
+        : file(path)
+        , header(nullptr)
+        , data(nullptr)
+    {
+        QDir().mkpath(QFileInfo(path).absolutePath());
+
+        if (capacity <= (qint64)sizeof(RecordHeader)
+            || !file.open(QIODevice::ReadWrite)) {
+            qCWarning(KAMD_LOG_RESOURCES) << "Can not open the event journal"
+                                          << path;
+            return;
+        }
+
+        // If the existing journal is not compatible, we are starting anew
+        bool reset = file.size() != headerSize + capacity;
+
+        if (reset && !file.resize(headerSize + capacity)) {
+            qCWarning(KAMD_LOG_RESOURCES) << "Can not resize the event journal"
+                                          << path;
+            return;
+        }
+
+        uchar *map = file.map(0, headerSize + capacity);
+
+        if (!map) {
+            qCWarning(KAMD_LOG_RESOURCES) << "Can not map the event journal"
+                                          << path;
+            return;
+        }
+
+        header = reinterpret_cast<Header *>(map);
+        data = map + headerSize;
+
+        if (reset || !isValidHeader(*header, file.size())) {
+            memcpy(header->magic, journalMagic, sizeof(journalMagic));
+            header->version    = journalVersion;
+            header->headerSize = headerSize;
+            header->capacity   = capacity;
+            header->head       = 0;
+            header->tail       = 0;
+            header->count      = 0;
+        }
+    }
+
+    ~Private()
+    {
+        if (header) {
+            file.unmap(reinterpret_cast<uchar *>(header));
+        }
+    }
+
+    // Forgets the oldest record
+    void dropOldest()
+    {
+        const auto size = recordSizeAt(data, header->capacity, header->head);
+
+        if (size == 0) {
+            // End of the lap, the next record is at the start
+            header->head = 0;
+            return;
+        }
+
+        header->head += size;
+        --header->count;
+    }
+
+    // Forgets the records that start in the [from, to) range
+    void evict(quint64 from, quint64 to)
+    {
+        while (header->count > 0
+               && header->head >= from && header->head < to) {
+            dropOldest();
+        }
+    }
+
+    void append(const Event &event, qint64 recorded)
+    {
+        const auto application = event.application.toUtf8();
+        const auto uri = event.uri.toUtf8();
+        const auto activity = event.activity.toUtf8();
+
+        RecordHeader record;
+        record.size            = sizeof(RecordHeader) + application.size()
+                                 + uri.size() + activity.size();
+        record.type            = event.type;
+        record.timestamp       = event.timestamp.toMSecsSinceEpoch();
+        record.recorded        = recorded;
+        record.wid             = event.wid;
+        record.repeatCount     = event.repeatCount;
+        record.applicationSize = application.size();
+        record.uriSize         = uri.size();
+        record.activitySize    = activity.size();
+
+        if (record.size > header->capacity) {
+            return;
+        }
+
+        if (header->tail + record.size > header->capacity) {
+            // The record does not fit at the end, starting a new lap
+            evict(header->tail, header->capacity);
+
+            if (header->tail + sizeof(quint32) <= header->capacity) {
+                const quint32 endOfLap = 0;
+                memcpy(data + header->tail, &endOfLap, sizeof(endOfLap));
+            }
+
+            header->tail = 0;
+        }
+
+        evict(header->tail, header->tail + record.size);
+
+        if (header->count == 0) {
+            header->head = header->tail;
+        }
+
+        uchar *position = data + header->tail;
+        memcpy(position, &record, sizeof(record));
+        position += sizeof(record);
+        memcpy(position, application.constData(), application.size());
+        position += application.size();
+        memcpy(position, uri.constData(), uri.size());
+        position += uri.size();
+        memcpy(position, activity.constData(), activity.size());
+
+        header->tail += record.size;
+        ++header->count;
+    }
+
+    QFile file;
+    Header *header;
+    uchar *data;
+};
+
+EventJournal::EventJournal(const QString &path, qint64 capacity)
+    : d(path, capacity)
+{
+}
+
+EventJournal::~EventJournal()
+{
+}
+
+bool EventJournal::isValid() const
+{
+    return d->header != nullptr;
+}
+
+void EventJournal::append(const EventList &events)
+{
+    if (!isValid()) {
+        return;
+    }
+
+    const auto recorded = QDateTime::currentMSecsSinceEpoch();
+
+    for (const auto &event: events) {
+        d->append(event, recorded);
+    }
+}
+
+QList<EventJournal::Record> EventJournal::read(const QString &path,
+                                               QString *error)
+{
+    QList<Record> result;
+
+    const auto fail = [&] (const QString &message) {
+        if (error) {
+            *error = message;
+        }
+        return result;
+    };
+
+    QFile file(path);
+
+    if (!file.open(QIODevice::ReadOnly)) {
+        return fail(file.errorString());
+    }
+
+    const auto contents = file.readAll();
+
+    Header header;
+
+    if (contents.size() < headerSize) {
+        return fail(QStringLiteral("The file is too short"));
+    }
+
+    memcpy(&header, contents.constData(), sizeof(header));
+
+    if (!isValidHeader(header, contents.size())) {
+        return fail(QStringLiteral("Not an event journal, or an incompatible version"));
+    }
+
+    const auto data = reinterpret_cast<const uchar *>(contents.constData()) + headerSize;
+
+    quint64 offset = header.head;
+
+    for (quint64 i = 0; i < header.count; ++i) {
+        auto size = recordSizeAt(data, header.capacity, offset);
+
+        if (size == 0) {
+            offset = 0;
+            size = recordSizeAt(data, header.capacity, offset);
+        }
+
+        RecordHeader record;
+
+        if (size < sizeof(record) || offset + size > header.capacity) {
+            return fail(QStringLiteral("The journal is corrupted"));
+        }
+
+        memcpy(&record, data + offset, sizeof(record));
+
+        if (sizeof(record) + record.applicationSize + record.uriSize
+                + record.activitySize != size
+            || record.applicationSize == 0 || record.uriSize == 0) {
+            return fail(QStringLiteral("The journal is corrupted"));
+        }
+
+        const auto strings = reinterpret_cast<const char *>(data + offset + sizeof(record));
+
+        Event event(QString::fromUtf8(strings, record.applicationSize),
+                    record.wid,
+                    QString::fromUtf8(strings + record.applicationSize, record.uriSize),
+                    record.type);
+        event.timestamp = QDateTime::fromMSecsSinceEpoch(record.timestamp);
+        event.repeatCount = record.repeatCount;
+        event.activity = QString::fromUtf8(
+            strings + record.applicationSize + record.uriSize, record.activitySize);
+
+        result << Record { event, record.recorded };
+
+        offset += size;
+    }
+
+    return result;
+}
+
+QString EventJournal::defaultPath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation)
+           + QStringLiteral("/kactivitymanagerd/events.journal");
+}
+
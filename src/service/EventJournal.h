@@ -0,0 +1,79 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+// Qt
+#include <QString>
+#include <QList>
+
+// Utils
+#include <utils/d_ptr.h>
+
+// Local
+#include "Event.h"
+
+
+/**
+ * Binary journal of the events that have passed through the
+ * Resources queue.
+ *
+ * The journal is a memory-mapped ring file - a fixed-size header
+ * followed by length-prefixed records. When the ring is full, the
+ * oldest records are overwritten. The records are stored in the
+ * native byte order, the journal is not meant to be portable.
+ */
+class EventJournal {
+public:
+    struct Record {
+        Event event;
+        qint64 recorded; ///< when the event was written, ms since epoch
+    };
+
+    /**
+     * Opens the journal, or creates it if it does not exist
+     * or has a different capacity
+     * @param path location of the journal file
+     * @param capacity size of the ring in bytes, without the header
+     */
+    EventJournal(const QString &path, qint64 capacity);
+    ~EventJournal();
+
+    bool isValid() const;
+
+    /**
+     * Appends the events to the journal. Not thread-safe,
+     * it is meant to be called only from the Resources thread
+     */
+    void append(const EventList &events);
+
+    /**
+     * Reads all the records from a journal, oldest first
+     */
+    static QList<Record> read(const QString &path, QString *error = nullptr);
+
+    static QString defaultPath();
+
+private:
+    D_PTR;
+};
+
+#endif // EVENT_JOURNAL_H
@@ -0,0 +1,366 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include <kactivities-features.h>
+#include "Replay.h"
+
+// Qt
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QUuid>
+
+// System
+#include <stdlib.h>
+#include <algorithm>
+#include <deque>
+
+// Local
+#include "ActivitiesSnapshot.h"
+#include "Application.h"
+#include "Config.h"
+#include "EventJournal.h"
+#include "Module.h"
+#include "Resources.h"
+
+
+namespace {
+
+/**
+ * Stands in for the Activities module, so that the replay
+ * does not depend on, nor change, the user's activities
+ */
+class ReplayActivities : public Module {
+    Q_OBJECT
+
+public:
+    ReplayActivities(QObject *parent)
+        : Module(QStringLiteral("activities"), parent)
+        , m_activity(QUuid::createUuid().toString().mid(1, 36))
+    {
+        // The activity is always running (Activities::Running)
+        ActivitiesSnapshot::publish(m_activity, { { m_activity, 2 } });
+    }
+
+public Q_SLOTS:
+    QString CurrentActivity() const
+    {
+        return m_activity;
+    }
+
+    QStringList ListActivities() const
+    {
+        return QStringList { m_activity };
+    }
+
+Q_SIGNALS:
+    void CurrentActivityChanged(const QString &activity);
+    void ActivityAdded(const QString &activity);
+    void ActivityRemoved(const QString &activity);
+
+private:
+    const QString m_activity;
+};
+
+struct Latency {
+    Latency()
+        : count(0)
+        , total(0)
+        , max(0)
+    {
+    }
+
+    void add(qint64 nsecs)
+    {
+        ++count;
+        total += nsecs;
+        max = std::max(max, nsecs);
+    }
+
+    QString toString() const
+    {
+        return QStringLiteral("avg %1 ms, max %2 ms (%3 samples)")
+            .arg(count ? total / 1e6 / count : 0.0, 0, 'f', 3)
+            .arg(max / 1e6, 0, 'f', 3)
+            .arg(count);
+    }
+
+    quint64 count;
+    qint64 total;
+    qint64 max;
+};
+
+/**
+ * Feeds the events to Resources, and follows them through the
+ * queue and the plugins. The ingestion is measured around the
+ * call to Resources, the queue stage lasts until the batch that
+ * contains the event is handed over to the plugins, and the
+ * processing stage until the plugins are done with the batch.
+ */
+class Replayer : public QObject {
+    Q_OBJECT
+
+public:
+    Replayer(Resources *resources, const QList<EventJournal::Record> &records,
+             bool fast)
+        : m_resources(resources)
+        , m_records(records)
+        , m_fast(fast)
+        , m_next(0)
+        , m_firstTimestamp(records.first().event.timestamp.toMSecsSinceEpoch())
+        , m_feedFinished(0)
+        , m_lastProcessed(0)
+    {
+        // This one is invoked in the Resources thread
+        connect(resources, &Resources::ProcessedResourceEvents,
+                this, [this] (const EventList &events) { batchEmitted(events); },
+                Qt::DirectConnection);
+
+        // Connected after the plugins, so it is invoked
+        // when they have finished processing the batch
+        connect(resources, &Resources::ProcessedResourceEvents,
+                this, &Replayer::batchProcessed, Qt::QueuedConnection);
+    }
+
+    void start()
+    {
+        m_start = QDateTime::currentDateTime();
+        m_timer.start();
+        feed();
+    }
+
+private Q_SLOTS:
+    void feed()
+    {
+        // In the fast mode, we are returning to the event loop every now
+        // and then to let the plugins process the batches in the meantime
+        const int chunk = 256;
+
+        const auto elapsed = m_timer.elapsed();
+        int fed = 0;
+
+        while (m_next < m_records.size()) {
+            Event event = m_records[m_next].event;
+
+            const auto due = std::max(Q_INT64_C(0),
+                event.timestamp.toMSecsSinceEpoch() - m_firstTimestamp);
+
+            if (m_fast ? fed == chunk : due > elapsed) {
+                const auto delay = m_fast ? 0 : due - elapsed;
+                QTimer::singleShot((int)delay, this, &Replayer::feed);
+                return;
+            }
+
+            // Keeping the recorded distances between the events
+            event.timestamp = m_start.addMSecs(due);
+
+            {
+                QMutexLocker locker(&m_mutex);
+                m_fedAt[key(event)] = m_timer.nsecsElapsed();
+            }
+
+            QElapsedTimer ingestion;
+            ingestion.start();
+
+            m_resources->replayEvent(event);
+
+            m_ingestion.add(ingestion.nsecsElapsed());
+
+            ++m_next;
+            ++fed;
+        }
+
+        m_feedFinished = m_timer.nsecsElapsed();
+        QTimer::singleShot(250, this, &Replayer::checkFinished);
+    }
+
+    void batchProcessed()
+    {
+        const auto now = m_timer.nsecsElapsed();
+
+        QMutexLocker locker(&m_mutex);
+
+        if (m_emittedAt.empty()) {
+            return;
+        }
+
+        m_processing.add(now - m_emittedAt.front());
+        m_emittedAt.pop_front();
+        m_lastProcessed = now;
+    }
+
+    void checkFinished()
+    {
+        bool idle = counter("queued") == 0;
+
+        {
+            QMutexLocker locker(&m_mutex);
+            idle = idle && m_emittedAt.empty();
+        }
+
+        // Giving the score maintainer the time to catch up
+        // with the last batch
+        const auto quiet = m_timer.nsecsElapsed()
+                           - std::max(m_feedFinished, m_lastProcessed);
+
+        if (!idle || quiet < Q_INT64_C(2000000000)) {
+            QTimer::singleShot(250, this, &Replayer::checkFinished);
+            return;
+        }
+
+        report();
+        QCoreApplication::exit(EXIT_SUCCESS);
+    }
+
+private:
+    static QString key(const Event &event)
+    {
+        return QString::number(event.type) + QLatin1Char(' ')
+               + QString::number(event.timestamp.toMSecsSinceEpoch())
+               + QLatin1Char(' ') + event.application
+               + QLatin1Char(' ') + event.uri;
+    }
+
+    void batchEmitted(const EventList &events)
+    {
+        const auto now = m_timer.nsecsElapsed();
+
+        QMutexLocker locker(&m_mutex);
+
+        for (const auto &event: events) {
+            const auto fed = m_fedAt.find(key(event));
+
+            if (fed != m_fedAt.end()) {
+                m_queue.add(now - *fed);
+                m_fedAt.erase(fed);
+            }
+        }
+
+        m_emittedAt.push_back(now);
+    }
+
+    quint64 counter(const char *name) const
+    {
+        return m_resources->featureValue(
+                   { QStringLiteral("ingestion"), QString::fromLatin1(name) })
+            .variant().toULongLong();
+    }
+
+    void report() const
+    {
+        const double seconds = std::max(m_feedFinished, m_lastProcessed) / 1e9;
+
+        QTextStream(stdout)
+            << "Replayed " << m_records.size() << " events "
+            << (m_fast ? "as fast as possible" : "at the recorded speed") << '\n'
+            << "  duration:   " << QString::number(seconds, 'f', 3) << " s, "
+            << QString::number(seconds > 0 ? m_records.size() / seconds : 0.0, 'f', 1)
+            << " events/s\n"
+            << "  ingestion:  " << m_ingestion.toString() << '\n'
+            << "  queue:      " << m_queue.toString() << '\n'
+            << "  processing: " << m_processing.toString() << '\n'
+            << "  merged: "      << counter("merged")
+            << ", short focus: " << counter("shortFocus")
+            << ", coalesced: "   << counter("coalesced")
+            << ", dropped: "     << counter("dropped") << '\n';
+    }
+
+    Resources *const m_resources;
+    const QList<EventJournal::Record> m_records;
+    const bool m_fast;
+    int m_next;
+
+    QDateTime m_start;
+    QElapsedTimer m_timer;
+    const qint64 m_firstTimestamp;
+
+    // The following are shared with the Resources thread
+    QMutex m_mutex;
+    QHash<QString, qint64> m_fedAt;
+    std::deque<qint64> m_emittedAt;
+
+    qint64 m_feedFinished;
+    qint64 m_lastProcessed;
+
+    Latency m_ingestion;
+    Latency m_queue;
+    Latency m_processing;
+};
+
+} // namespace
+
+int replayJournal(Application &application, const QString &journal, bool fast)
+{
+    QString error;
+    const auto records = EventJournal::read(journal, &error);
+
+    if (!error.isEmpty()) {
+        QTextStream(stderr) << "Can not read the journal: " << error << '\n';
+        return EXIT_FAILURE;
+    }
+
+    if (records.isEmpty()) {
+        QTextStream(stdout) << "The journal is empty\n";
+        return EXIT_SUCCESS;
+    }
+
+    // Keeping the replay away from the user's configuration and data,
+    // this also means the replay itself is not journalled
+    QStandardPaths::setTestModeEnabled(true);
+
+    QTemporaryDir scratch;
+
+    if (!scratch.isValid()) {
+        QTextStream(stderr) << "Can not create the scratch directory\n";
+        return EXIT_FAILURE;
+    }
+
+    // The database is opened by the plugin, these are the properties
+    // that ResourcesDatabaseSchema::overridePath would have set
+    application.setProperty(
+        "org.kde.KActivities.ResourcesDatabase.overrideDatabase", true);
+    application.setProperty(
+        "org.kde.KActivities.ResourcesDatabase.overrideDatabaseFile",
+        scratch.path() + QStringLiteral("/database"));
+
+    new ReplayActivities(&application);
+    new Config(&application);
+    auto resources = new Resources(&application);
+
+    if (!application.loadPlugin(
+            QStringLiteral("org.kde.ActivityManager.ResourceScoring"))) {
+        QTextStream(stderr) << "Can not load the resource scoring plugin\n";
+        return EXIT_FAILURE;
+    }
+
+    Replayer replayer(resources, records, fast);
+    replayer.start();
+
+    return application.exec();
+}
+
+#include "Replay.moc"
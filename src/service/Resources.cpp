@@ -27,10 +27,14 @@
 #include <QThread>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QDateTime>
+#include <QDBusMessage>
 
 // KDE
 #include <kwindowsystem.h>
 #include <kdbusconnectionpool.h>
+#include <ksharedconfig.h>
+#include <kconfiggroup.h>
 
 // Utils
 #include <utils/d_ptr_implementation.h>
@@ -38,10 +42,14 @@
 
 // System
 #include <time.h>
+#include <algorithm>
+#include <iterator>
 
 // Local
+#include "DebugResources.h"
 #include "Application.h"
 #include "Activities.h"
+#include "ActivityStore.h"
 #include "resourcesadaptor.h"
 #include "common/dbus/common.h"
 
@@ -49,8 +57,23 @@
 Resources::Private::Private(Resources *parent)
     : QThread(parent)
     , focussedWindow(0)
+    , overloadPolicy(DropOldest)
+    , maxQueuedEvents(0)
+    , maxQueuedEventsPerApplication(0)
+    , rateLimit(0)
+    , rateLimitBurst(0)
+    , coalesceWindow(0)
+    , shortFocusThreshold(0)
+    , droppedEvents(0)
+    , coalescedEvents(0)
+    , rateLimitedEvents(0)
+    , mergedEvents(0)
+    , shortFocusEvents(0)
+    , socketEnabled(false)
+    , socket(nullptr)
     , q(parent)
 {
+    loadConfiguration();
 }
 
 Resources::Private::~Private()
@@ -62,6 +85,199 @@ Resources::Private::~Private()
 namespace {
 EventList events;
 QMutex events_mutex;
+
+// Incremented every time the queue is handed over for processing
+quint64 events_batch = 0;
+
+// Number of the queued events of each application, so that checking
+// the per-application limit does not need to go through the queue
+QHash<QString, int> events_perApplication;
+
+inline void eventQueued(const Event &event)
+{
+    ++events_perApplication[event.application];
+}
+
+inline void eventsUnqueued(const QString &application, int count = 1)
+{
+    const auto it = events_perApplication.find(application);
+
+    if (it != events_perApplication.end() && (*it -= count) <= 0) {
+        events_perApplication.erase(it);
+    }
+}
+}
+
+void Resources::Private::loadConfiguration()
+{
+    const auto config
+        = ActivityStore::settings()->group("Resources");
+
+    const auto policy = config.readEntry("overload-policy", "drop-oldest");
+
+    overloadPolicy =
+        policy == QLatin1String("drop-newest")     ? DropNewest :
+        policy == QLatin1String("coalesce-by-uri") ? CoalesceByUri :
+        policy == QLatin1String("rate-limit")      ? RateLimit :
+                                                     DropOldest;
+
+    // Zero or a negative value disables the corresponding limit
+    maxQueuedEvents = config.readEntry("max-queued-events", 2000);
+    maxQueuedEventsPerApplication
+        = config.readEntry("max-queued-events-per-application", 500);
+
+    rateLimit      = config.readEntry("rate-limit", 50.0);
+    rateLimitBurst = config.readEntry("rate-limit-burst", 100.0);
+
+    // Editors tend to re-send the same event every few hundred
+    // milliseconds, there is no point in storing all of them
+    coalesceWindow = config.readEntry("coalesce-window", 1000);
+    shortFocusThreshold = config.readEntry("short-focus-threshold", 300);
+
+    const auto typeNames = config.readEntry("coalesced-event-types",
+        QStringList { QStringLiteral("Accessed"),
+                      QStringLiteral("Modified"),
+                      QStringLiteral("FocussedIn") });
+
+    coalescedTypes.clear();
+    Event event;
+    for (int type = Event::Accessed; type <= Event::LastEventType; ++type) {
+        event.type = type;
+        if (typeNames.contains(event.typeName())) {
+            coalescedTypes << type;
+        }
+    }
+
+    // The journal records everything that leaves the queue,
+    // so that the event stream can be replayed later
+    if (config.readEntry("journal", false)) {
+        const auto path = config.readEntry("journal-file", EventJournal::defaultPath());
+        const qint64 size = config.readEntry("journal-size", 16); // MiB
+
+        journal.reset(new EventJournal(path, size * 1024 * 1024));
+
+        if (!journal->isValid()) {
+            journal.reset();
+        }
+    }
+
+    // Opt-in endpoint for the clients that send events
+    // too often for D-Bus to be comfortable
+    socketEnabled = config.readEntry("ingestion-socket", false);
+
+    qCDebug(KAMD_LOG_RESOURCES) << "Ingestion limits:" << policy
+                                << maxQueuedEvents
+                                << maxQueuedEventsPerApplication
+                                << rateLimit << rateLimitBurst;
+    qCDebug(KAMD_LOG_RESOURCES) << "Coalescing:" << coalesceWindow
+                                << typeNames << shortFocusThreshold;
+}
+
+bool Resources::Private::consumeToken(const QString &sender)
+{
+    if (rateLimit <= 0 || sender.isEmpty()) {
+        return true;
+    }
+
+    const auto now = QDateTime::currentMSecsSinceEpoch();
+
+    // Forgetting the senders whose buckets have been refilled
+    // so that we do not collect every unique name we have seen
+    if (tokenBuckets.size() > 256) {
+        for (auto it = tokenBuckets.begin(); it != tokenBuckets.end(); ) {
+            const bool refilled =
+                it->tokens + (now - it->lastRefill) * rateLimit / 1000.0
+                    >= rateLimitBurst;
+
+            if (refilled) {
+                it = tokenBuckets.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    auto bucket = tokenBuckets.find(sender);
+
+    if (bucket == tokenBuckets.end()) {
+        bucket = tokenBuckets.insert(sender, TokenBucket { rateLimitBurst, now });
+    }
+
+    bucket->tokens = std::min(rateLimitBurst,
+        bucket->tokens + (now - bucket->lastRefill) * rateLimit / 1000.0);
+    bucket->lastRefill = now;
+
+    if (bucket->tokens < 1.0) {
+        return false;
+    }
+
+    bucket->tokens -= 1.0;
+    return true;
+}
+
+bool Resources::Private::enqueueEvent(const Event &newEvent)
+{
+    QMutexLocker locker(&events_mutex);
+
+    const bool queueFull =
+        maxQueuedEvents > 0 && events.size() >= maxQueuedEvents;
+
+    const bool applicationFull =
+        maxQueuedEventsPerApplication > 0
+        && events_perApplication.value(newEvent.application)
+               >= maxQueuedEventsPerApplication;
+
+    if (!queueFull && !applicationFull) {
+        events << newEvent;
+        eventQueued(newEvent);
+        return true;
+    }
+
+    switch (overloadPolicy) {
+        case DropOldest: {
+            // If only the application is over its limit, we are removing
+            // its oldest event, not somebody else's
+            const auto oldest = !applicationFull ? events.begin() :
+                std::find_if(events.begin(), events.end(),
+                    [&newEvent](const Event &event) {
+                        return event.application == newEvent.application;
+                    });
+
+            eventsUnqueued(oldest->application);
+            events.erase(oldest);
+            events << newEvent;
+            eventQueued(newEvent);
+            ++droppedEvents;
+            return true;
+        }
+
+        case CoalesceByUri: {
+            const auto queued = std::find_if(events.begin(), events.end(),
+                [&newEvent](const Event &event) {
+                    return event.application == newEvent.application
+                        && event.uri         == newEvent.uri
+                        && event.type        == newEvent.type;
+                });
+
+            // The event replaces the queued one, so it is
+            // registered even if the queue did not grow
+            if (queued != events.end()) {
+                *queued = newEvent;
+                ++coalescedEvents;
+                return true;
+            }
+
+            // Nothing to merge with, dropping the new event
+            break;
+        }
+
+        case DropNewest:
+        case RateLimit:
+            break;
+    }
+
+    ++droppedEvents;
+    return false;
 }
 
 void Resources::Private::run()
@@ -80,12 +296,95 @@ void Resources::Private::run()
             }
 
             std::swap(currentEvents, events);
+            events_perApplication.clear();
+            ++events_batch;
+        }
+
+        if (journal) {
+            journal->append(currentEvents);
         }
 
         emit q->ProcessedResourceEvents(currentEvents);
     }
 }
 
+Resources::Private::CoalescingResult
+Resources::Private::coalesceEvent(const Event &newEvent)
+{
+    if (coalesceWindow <= 0 && shortFocusThreshold <= 0) {
+        return Unchanged;
+    }
+
+    QMutexLocker locker(&events_mutex);
+
+    const auto key = qMakePair(newEvent.application, newEvent.uri);
+    const auto seen = seenEvents.find(key);
+
+    if (seen != seenEvents.end()) {
+        const auto elapsed = seen->timestamp.msecsTo(newEvent.timestamp);
+
+        // If the batch has changed, the previous event has already
+        // been passed on to the plugins
+        const bool sameBatch = seen->batch == events_batch;
+
+        const auto queued = std::find_if(events.rbegin(), events.rend(),
+            [&](const Event &event) {
+                return event.application == newEvent.application
+                    && event.uri         == newEvent.uri
+                    && event.type        == seen->type;
+            });
+
+        if (newEvent.type == Event::FocussedOut
+            && seen->type == Event::FocussedIn
+            && elapsed < shortFocusThreshold
+            && sameBatch) {
+            // The FocussedIn might have already been removed
+            // by the event that caused this FocussedOut
+            if (queued != events.rend()) {
+                eventsUnqueued(queued->application);
+                events.erase(std::next(queued).base());
+            }
+
+            ++shortFocusEvents;
+            seenEvents.erase(seen);
+            return ShortFocus;
+        }
+
+        if (newEvent.type == seen->type
+            && coalescedTypes.contains(newEvent.type)
+            && elapsed <= coalesceWindow) {
+
+            if (queued != events.rend()) {
+                ++queued->repeatCount;
+                ++mergedEvents;
+                return Merged;
+            }
+
+            // The previous event has already been passed on to the
+            // plugins, or superseded by a newer one, so there is no
+            // event to count the repeat in. This one needs to be
+            // queued again so that it is not lost for the scoring
+        }
+    }
+
+    // Forgetting the events that can not be merged with anything
+    if (seenEvents.size() > 1024) {
+        const auto horizon = std::max(coalesceWindow, shortFocusThreshold);
+
+        for (auto it = seenEvents.begin(); it != seenEvents.end(); ) {
+            if (it->timestamp.msecsTo(newEvent.timestamp) > horizon) {
+                it = seenEvents.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+
+    seenEvents[key] = SeenEvent { newEvent.type, newEvent.timestamp, events_batch };
+
+    return Unchanged;
+}
+
 void Resources::Private::insertEvent(const Event &newEvent)
 {
     if (lastEvent == newEvent) {
@@ -94,14 +393,47 @@ void Resources::Private::insertEvent(const Event &newEvent)
 
     lastEvent = newEvent;
 
-    {
-        QMutexLocker locker(&events_mutex);
-        events << newEvent;
+    switch (coalesceEvent(newEvent)) {
+        case Merged:
+            // Nobody needs to hear about a repeated event
+            return;
+
+        case ShortFocus:
+            // Not worth storing, but the live listeners
+            // need to know where the focus is
+            break;
+
+        case Unchanged:
+            if (!enqueueEvent(newEvent)) {
+                return;
+            }
+            break;
     }
 
     emit q->RegisteredResourceEvent(newEvent);
 }
 
+void Resources::Private::registerEvent(const QString &sender,
+                                       const QString &application,
+                                       uint windowId, const QString &uri,
+                                       uint event)
+{
+    if (event > Event::LastEventType
+        || uri.isEmpty()
+        || application.isEmpty()) {
+        return;
+    }
+
+    // Throttling the clients that send more events than they should
+    if (overloadPolicy == RateLimit && !sender.isEmpty()
+        && !consumeToken(sender)) {
+        ++rateLimitedEvents;
+        return;
+    }
+
+    addEvent(application, (WId)windowId, uri, (Event::Type)event);
+}
+
 void Resources::Private::addEvent(const QString &application, WId wid,
                                   const QString &uri, int type)
 {
@@ -118,12 +450,16 @@ void Resources::Private::addEvent(const Event &newEvent)
         // Deleting previously registered Accessed events if
         // the current one has the same application and uri
         if (newEvent.type != Event::Accessed) {
+            const int queued = events.size();
+
             kamd::utils::remove_if(events, [&newEvent](const Event &event)->bool {
                 return
                     event.application == newEvent.application &&
                     event.uri         == newEvent.uri
                 ;
             });
+
+            eventsUnqueued(newEvent.application, queued - events.size());
         }
     }
 
@@ -278,24 +614,37 @@ Resources::Resources(QObject *parent)
             d.operator->(),        &Resources::Private::windowClosed);
     connect(KWindowSystem::self(), &KWindowSystem::activeWindowChanged,
             d.operator->(),        &Resources::Private::activeWindowChanged);
+
+    if (d->socketEnabled) {
+        d->socket = new ResourcesSocket(this);
+
+        connect(d->socket, &ResourcesSocket::eventReceived,
+                this, [this] (const QString &sender, const QString &application,
+                              uint windowId, const QString &uri, uint event) {
+                    d->registerEvent(sender, application, windowId, uri, event);
+                });
+
+        // We are going to be moved to a separate thread,
+        // the socket needs to be created there
+        QMetaObject::invokeMethod(d->socket, "listen", Qt::QueuedConnection);
+    }
 }
 
 Resources::~Resources()
 {
 }
 
-void Resources::RegisterResourceEvent(const QString &application, uint _windowId,
+void Resources::RegisterResourceEvent(const QString &application, uint windowId,
                                       const QString &uri, uint event)
 {
-    if (event > Event::LastEventType
-        || uri.isEmpty()
-        || application.isEmpty()) {
-        return;
-    }
-
-    WId windowId = (WId)_windowId;
+    d->registerEvent(calledFromDBus() ? message().service() : QString(),
+                     application, windowId, uri, event);
+}
 
-    d->addEvent(application, windowId, uri, (Event::Type)event);
+void Resources::replayEvent(const Event &event)
+{
+    d->insertEvent(event);
+    d->start();
 }
 
 void Resources::RegisterResourceMimetype(const QString &uri, const QString &mimetype)
@@ -317,3 +666,66 @@ void Resources::RegisterResourceTitle(const QString &uri, const QString &title)
     emit RegisteredResourceTitle(uri, title);
 }
 
+bool Resources::isFeatureOperational(const QStringList &feature) const
+{
+    return !feature.isEmpty() && feature[0] == QLatin1String("ingestion");
+}
+
+QStringList Resources::listFeatures(const QStringList &feature) const
+{
+    if (feature.isEmpty() || feature[0].isEmpty()) {
+        return { QStringLiteral("ingestion/") };
+
+    } else if (feature[0] == QLatin1String("ingestion")) {
+        return {
+            QStringLiteral("queued"),
+            QStringLiteral("dropped"),
+            QStringLiteral("coalesced"),
+            QStringLiteral("rateLimited"),
+            QStringLiteral("merged"),
+            QStringLiteral("shortFocus"),
+            QStringLiteral("socketEvents"),
+            QStringLiteral("socketRejected")
+        };
+    }
+
+    return QStringList();
+}
+
+QDBusVariant Resources::featureValue(const QStringList &property) const
+{
+    if (property.size() != 2 || property[0] != QLatin1String("ingestion")) {
+        return QDBusVariant();
+    }
+
+    const auto &counter = property[1];
+
+    if (counter == QLatin1String("queued")) {
+        QMutexLocker locker(&events_mutex);
+        return QDBusVariant((qulonglong)events.size());
+
+    } else if (counter == QLatin1String("dropped")) {
+        return QDBusVariant((qulonglong)d->droppedEvents.load());
+
+    } else if (counter == QLatin1String("coalesced")) {
+        return QDBusVariant((qulonglong)d->coalescedEvents.load());
+
+    } else if (counter == QLatin1String("rateLimited")) {
+        return QDBusVariant((qulonglong)d->rateLimitedEvents.load());
+
+    } else if (counter == QLatin1String("merged")) {
+        return QDBusVariant((qulonglong)d->mergedEvents.load());
+
+    } else if (counter == QLatin1String("shortFocus")) {
+        return QDBusVariant((qulonglong)d->shortFocusEvents.load());
+
+    } else if (counter == QLatin1String("socketEvents")) {
+        return QDBusVariant((qulonglong)(d->socket ? d->socket->receivedEvents() : 0));
+
+    } else if (counter == QLatin1String("socketRejected")) {
+        return QDBusVariant((qulonglong)(d->socket ? d->socket->rejectedConnections() : 0));
+
+    }
+
+    return QDBusVariant();
+}
@@ -24,6 +24,7 @@
 // Qt
 #include <QString>
 #include <QStringList>
+#include <QDBusContext>
 
 // Utils
 #include <utils/d_ptr.h>
@@ -36,7 +37,7 @@
 /**
  * Resources
  */
-class Resources : public Module {
+class Resources : public Module, protected QDBusContext {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.ActivityManager.Resources")
 
@@ -44,6 +45,17 @@ public:
     explicit Resources(QObject *parent = nullptr);
     ~Resources() override;
 
+    bool isFeatureOperational(const QStringList &feature) const override;
+    QStringList listFeatures(const QStringList &feature) const override;
+    QDBusVariant featureValue(const QStringList &property) const override;
+
+    /**
+     * Inserts an event read from the journal. The event skips the
+     * window tracking since the journal contains the derived events
+     * as well, but it goes through the coalescing and the queue limits
+     */
+    void replayEvent(const Event &event);
+
 public Q_SLOTS:
     /**
      * Registers a new event
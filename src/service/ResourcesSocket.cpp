@@ -0,0 +1,217 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "ResourcesSocket.h"
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// System
+#include <atomic>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// Local
+#include "DebugResources.h"
+#include <common/socket/EventFraming.h>
+
+
+class ResourcesSocket::Private {
+public:
+    Private(ResourcesSocket *parent)
+        : server(nullptr)
+        , receivedEvents(0)
+        , rejectedConnections(0)
+        , lastConnection(0)
+        , q(parent)
+    {
+    }
+
+    // Returns the process id of the peer, or -1 if the peer
+    // is not running as the same user as we are. Zero if the
+    // user can be checked, but the process id is not known
+    static qint64 peerProcess(QLocalSocket *socket)
+    {
+        const int fd = socket->socketDescriptor();
+
+#ifdef SO_PEERCRED
+        struct ucred credentials;
+        socklen_t size = sizeof(credentials);
+
+        if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) != 0
+            || credentials.uid != getuid()) {
+            return -1;
+        }
+
+        return credentials.pid;
+#else
+        uid_t uid;
+        gid_t gid;
+
+        if (getpeereid(fd, &uid, &gid) != 0 || uid != getuid()) {
+            return -1;
+        }
+
+        return 0;
+#endif
+    }
+
+    void newConnection()
+    {
+        while (auto socket = server->nextPendingConnection()) {
+            const auto pid = peerProcess(socket);
+
+            if (pid < 0) {
+                qCWarning(KAMD_LOG_RESOURCES)
+                    << "Rejecting a connection from another user";
+                ++rejectedConnections;
+                socket->abort();
+                socket->deleteLater();
+                continue;
+            }
+
+            // Without the process id, each connection is a sender
+            // of its own, the rate limit would be shared otherwise
+            const auto sender =
+                pid > 0 ? QStringLiteral("pid:") + QString::number(pid)
+                        : QStringLiteral("connection:") + QString::number(++lastConnection);
+
+            QObject::connect(socket, &QLocalSocket::readyRead,
+                             q, [this, socket, sender] {
+                                 readFrames(socket, sender);
+                             });
+            QObject::connect(socket, &QLocalSocket::disconnected,
+                             socket, &QObject::deleteLater);
+
+            // There might already be something to read
+            readFrames(socket, sender);
+        }
+    }
+
+    void readFrames(QLocalSocket *socket, const QString &sender)
+    {
+        using namespace Common::EventFraming;
+
+        char prefix[sizeSize];
+
+        while (socket->peek(prefix, sizeSize) == sizeSize) {
+            const auto size = payloadSize(prefix);
+
+            if (size > maxPayloadSize) {
+                qCWarning(KAMD_LOG_RESOURCES)
+                    << "Frame too big, closing the connection of" << sender;
+                socket->abort();
+                return;
+            }
+
+            if (socket->bytesAvailable() < sizeSize + size) {
+                return;
+            }
+
+            socket->skip(sizeSize);
+            Frame frame;
+
+            if (!decode(socket->read(size), frame)) {
+                qCWarning(KAMD_LOG_RESOURCES)
+                    << "Malformed frame, closing the connection of" << sender;
+                socket->abort();
+                return;
+            }
+
+            ++receivedEvents;
+
+            emit q->eventReceived(sender, frame.application, frame.windowId,
+                                  frame.uri, frame.type);
+        }
+    }
+
+    QLocalServer *server;
+
+    std::atomic<quint64> receivedEvents;
+    std::atomic<quint64> rejectedConnections;
+
+    // Used only from the thread of the server
+    quint64 lastConnection;
+
+private:
+    ResourcesSocket *const q;
+};
+
+ResourcesSocket::ResourcesSocket(QObject *parent)
+    : QObject(parent)
+    , d(this)
+{
+}
+
+ResourcesSocket::~ResourcesSocket()
+{
+}
+
+void ResourcesSocket::listen()
+{
+    if (d->server) {
+        return;
+    }
+
+    const auto path = Common::EventFraming::socketPath();
+    const auto directory = QFileInfo(path).absolutePath();
+
+    QDir().mkpath(directory);
+    QFile::setPermissions(directory, QFile::ReadOwner | QFile::WriteOwner
+                                         | QFile::ExeOwner);
+
+    // Removing the leftover socket, if we have crashed previously
+    QLocalServer::removeServer(path);
+
+    // Created here, so that it belongs to the thread we live in
+    d->server = new QLocalServer(this);
+    d->server->setSocketOptions(QLocalServer::UserAccessOption);
+
+    connect(d->server, &QLocalServer::newConnection,
+            this, [this] { d->newConnection(); });
+
+    if (!d->server->listen(path)) {
+        qCWarning(KAMD_LOG_RESOURCES) << "Can not listen on" << path
+                                      << d->server->errorString();
+        return;
+    }
+
+    qCDebug(KAMD_LOG_RESOURCES) << "Listening for resource events on" << path;
+}
+
+quint64 ResourcesSocket::receivedEvents() const
+{
+    return d->receivedEvents;
+}
+
+quint64 ResourcesSocket::rejectedConnections() const
+{
+    return d->rejectedConnections;
+}
+
@@ -0,0 +1,69 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RESOURCES_SOCKET_H
+#define RESOURCES_SOCKET_H
+
+// Qt
+#include <QObject>
+#include <QString>
+
+// Utils
+#include <utils/d_ptr.h>
+
+
+/**
+ * Local ingestion endpoint for the resource events.
+ *
+ * Listens on a Unix socket in the runtime directory, and accepts
+ * only the connections from processes of the same user. The frames
+ * are described in common/socket/EventFraming.h
+ */
+class ResourcesSocket : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ResourcesSocket(QObject *parent = nullptr);
+    ~ResourcesSocket() override;
+
+    // Counters, these can be read from other threads
+    quint64 receivedEvents() const;
+    quint64 rejectedConnections() const;
+
+public Q_SLOTS:
+    /**
+     * Starts listening. This needs to be called from the
+     * thread the object lives in
+     */
+    void listen();
+
+Q_SIGNALS:
+    /**
+     * Emitted for every valid frame
+     * @param sender identifies the client process, in the form pid:N
+     */
+    void eventReceived(const QString &sender, const QString &application,
+                       uint windowId, const QString &uri, uint event);
+
+private:
+    D_PTR;
+};
+
+#endif // RESOURCES_SOCKET_H
@@ -29,8 +29,14 @@
 #include <QList>
 #include <QWindow> // for WId
 
+// STL
+#include <atomic>
+#include <memory>
+
 // Local
 #include "resourcesadaptor.h"
+#include "EventJournal.h"
+#include "ResourcesSocket.h"
 
 
 class Resources::Private : public QThread {
@@ -42,9 +48,43 @@ public:
 
     void run() override;
 
+    // What to do when the pending queue, or the share of the queue
+    // that belongs to a single application, is full
+    enum OverloadPolicy {
+        DropOldest = 0,    ///< make room by removing the oldest queued event
+        DropNewest = 1,    ///< reject the event that is being registered
+        CoalesceByUri = 2, ///< merge with a queued event for the same resource
+        RateLimit = 3      ///< per-sender token bucket, then drop the newest
+    };
+
+    void loadConfiguration();
+
     // Inserts the event directly into the queue
     void insertEvent(const Event &newEvent);
 
+    // Result of the coalescing stage that events pass through
+    // before they reach the queue
+    enum CoalescingResult {
+        Unchanged, ///< the event needs to be queued
+        Merged,    ///< the event repeats a recent one, and was merged into it
+        ShortFocus ///< the focus was too short for the pair to be stored
+    };
+
+    CoalescingResult coalesceEvent(const Event &newEvent);
+
+    // Appends the event to the queue, respecting the configured
+    // limits. Returns false if the event was dropped
+    bool enqueueEvent(const Event &newEvent);
+
+    // Takes a token from the bucket of the specified D-Bus sender.
+    // Returns false if the sender has exceeded its rate
+    bool consumeToken(const QString &sender);
+
+    // Validates and throttles the event coming from the specified
+    // sender, and passes it on to addEvent
+    void registerEvent(const QString &sender, const QString &application,
+                       uint windowId, const QString &uri, uint event);
+
     // Processes the event and inserts it into the queue
     void addEvent(const QString &application, WId wid, const QString &uri,
                   int type);
@@ -72,6 +112,51 @@ private:
     QHash<WId, WindowData> windows;
     WId focussedWindow;
 
+public:
+    // Ingestion limits
+    OverloadPolicy overloadPolicy;
+    int maxQueuedEvents;
+    int maxQueuedEventsPerApplication;
+    double rateLimit;      // events per second
+    double rateLimitBurst; // bucket capacity
+
+    struct TokenBucket {
+        double tokens;
+        qint64 lastRefill;
+    };
+
+    QHash<QString, TokenBucket> tokenBuckets;
+
+    // Coalescing rules
+    int coalesceWindow;      // ms, repeats inside it are merged
+    QSet<int> coalescedTypes;
+    int shortFocusThreshold; // ms, shorter focus pairs are not stored
+
+    struct SeenEvent {
+        int type;
+        QDateTime timestamp;
+        quint64 batch;
+    };
+
+    // The last event seen for an (application, resource) pair
+    QHash<QPair<QString, QString>, SeenEvent> seenEvents;
+
+    // Ingestion counters, these are read from other
+    // threads through featureValue
+    std::atomic<quint64> droppedEvents;
+    std::atomic<quint64> coalescedEvents;
+    std::atomic<quint64> rateLimitedEvents;
+    std::atomic<quint64> mergedEvents;
+    std::atomic<quint64> shortFocusEvents;
+
+    // Records the processed events, null unless enabled
+    std::unique_ptr<EventJournal> journal;
+
+    // Local socket endpoint, null unless enabled
+    bool socketEnabled;
+    ResourcesSocket *socket;
+
+private:
     Resources *const q;
 };
 
@@ -0,0 +1,181 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "StartupProfiler.h"
+
+// Qt
+#include <QCoreApplication>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QVector>
+
+
+namespace {
+    struct Record {
+        QString name;
+        qint64 start;    // us since the profiler was loaded
+        qint64 duration; // us
+        int thread;
+    };
+
+    struct Counter {
+        QString name;
+        qint64 time;     // us since the profiler was loaded
+        qint64 value;
+        int thread;
+    };
+
+    QElapsedTimer &clock()
+    {
+        static QElapsedTimer timer;
+
+        if (!timer.isValid()) {
+            timer.start();
+        }
+
+        return timer;
+    }
+
+    // Starting the clock as soon as the library is loaded
+    const bool s_clockStarted = clock().isValid();
+
+    QMutex s_mutex;
+    bool s_finished = false;
+    QVector<Record> s_records;
+    QVector<Counter> s_counters;
+    QHash<Qt::HANDLE, int> s_threads;
+
+    // Needs to be called with the mutex locked
+    int threadIndex()
+    {
+        const auto thread = QThread::currentThreadId();
+
+        auto it = s_threads.constFind(thread);
+        if (it == s_threads.constEnd()) {
+            it = s_threads.insert(thread, s_threads.size() + 1);
+        }
+
+        return *it;
+    }
+}
+
+StartupProfiler::Phase::Phase(const QString &name)
+    : m_name(name)
+    , m_start(clock().nsecsElapsed() / 1000)
+{
+}
+
+StartupProfiler::Phase::~Phase()
+{
+    const auto end = clock().nsecsElapsed() / 1000;
+
+    QMutexLocker lock(&s_mutex);
+
+    if (s_finished) return;
+
+    s_records << Record { m_name, m_start, end - m_start, threadIndex() };
+}
+
+void StartupProfiler::finish()
+{
+    const auto end = clock().nsecsElapsed() / 1000;
+
+    QMutexLocker lock(&s_mutex);
+
+    if (s_finished) return;
+
+    s_records << Record { QStringLiteral("startup"), 0, end, threadIndex() };
+    s_finished = true;
+}
+
+void StartupProfiler::counter(const QString &name, qint64 value)
+{
+    const auto time = clock().nsecsElapsed() / 1000;
+
+    QMutexLocker lock(&s_mutex);
+
+    s_counters << Counter { name, time, value, threadIndex() };
+}
+
+QStringList StartupProfiler::phases()
+{
+    QMutexLocker lock(&s_mutex);
+
+    QStringList result;
+
+    for (const auto &record: s_records) {
+        result << QStringLiteral("%1: %2ms (at %3ms, thread %4)")
+                      .arg(record.name)
+                      .arg(record.duration / 1000.0, 0, 'f', 3)
+                      .arg(record.start / 1000.0, 0, 'f', 3)
+                      .arg(record.thread);
+    }
+
+    for (const auto &counter: s_counters) {
+        result << QStringLiteral("%1: %2 (at %3ms)")
+                      .arg(counter.name)
+                      .arg(counter.value)
+                      .arg(counter.time / 1000.0, 0, 'f', 3);
+    }
+
+    return result;
+}
+
+QByteArray StartupProfiler::chromeTrace()
+{
+    QMutexLocker lock(&s_mutex);
+
+    QJsonArray events;
+
+    for (const auto &record: s_records) {
+        events << QJsonObject {
+            { QStringLiteral("name"), record.name },
+            { QStringLiteral("ph"),   QStringLiteral("X") },
+            { QStringLiteral("ts"),   (double)record.start },
+            { QStringLiteral("dur"),  (double)record.duration },
+            { QStringLiteral("pid"),  (double)QCoreApplication::applicationPid() },
+            { QStringLiteral("tid"),  record.thread }
+        };
+    }
+
+    for (const auto &counter: s_counters) {
+        events << QJsonObject {
+            { QStringLiteral("name"), counter.name },
+            { QStringLiteral("ph"),   QStringLiteral("C") },
+            { QStringLiteral("ts"),   (double)counter.time },
+            { QStringLiteral("pid"),  (double)QCoreApplication::applicationPid() },
+            { QStringLiteral("tid"),  counter.thread },
+            { QStringLiteral("args"), QJsonObject {
+                  { QStringLiteral("value"), (double)counter.value }
+              } }
+        };
+    }
+
+    return QJsonDocument(QJsonObject {
+            { QStringLiteral("traceEvents"), events },
+            { QStringLiteral("displayTimeUnit"), QStringLiteral("ms") }
+        }).toJson(QJsonDocument::Compact);
+}
@@ -0,0 +1,77 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STARTUP_PROFILER_H
+#define STARTUP_PROFILER_H
+
+#include "kactivitymanagerd_plugin_export.h"
+
+// Qt
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * Records how long the phases of the service startup take, in which
+ * thread, and when they started relative to the start of the process.
+ */
+class KACTIVITYMANAGERD_PLUGIN_EXPORT StartupProfiler {
+public:
+    /**
+     * Records the phase from its creation until it is destroyed
+     */
+    class KACTIVITYMANAGERD_PLUGIN_EXPORT Phase {
+    public:
+        explicit Phase(const QString &name);
+        ~Phase();
+
+    private:
+        const QString m_name;
+        const qint64 m_start;
+    };
+
+    /**
+     * Marks the startup as finished. The phases that start
+     * after this are not recorded
+     */
+    static void finish();
+
+    /**
+     * Records a value measured at the current time, like the memory
+     * usage. Unlike the phases, counters are recorded after the startup
+     * has finished as well
+     */
+    static void counter(const QString &name, qint64 value);
+
+    /**
+     * @returns the phases and the counters, one line per record
+     */
+    static QStringList phases();
+
+    /**
+     * @returns the phases and the counters in the Chrome trace event format, which can
+     * be opened in chrome://tracing or similar tools
+     */
+    static QByteArray chromeTrace();
+};
+
+#endif // STARTUP_PROFILER_H
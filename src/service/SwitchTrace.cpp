@@ -0,0 +1,214 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Self
+#include "SwitchTrace.h"
+
+// Qt
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+
+// STL
+#include <deque>
+
+
+namespace {
+    // How many switches we keep for inspection
+    const std::size_t latestCount = 32;
+
+    // The handlers reported this long after the switch started
+    // do not belong to it any more
+    const qint64 maximumAge = 60 * 1000 * 1000; // us
+
+    // Upper bounds of the histogram buckets, in ms. The last
+    // bucket holds everything that took longer
+    const qint64 bucketBounds[] = {
+        1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000
+    };
+    const int bucketCount = sizeof(bucketBounds) / sizeof(bucketBounds[0]) + 1;
+
+    struct Stage {
+        QString name;
+        qint64 offset;   // us since the switch started
+        qint64 duration; // us, -1 for the stages that are not handlers
+    };
+
+    struct Switch {
+        quint64 id;
+        QString activity;
+        QElapsedTimer timer;
+        QVector<Stage> stages;
+    };
+
+    QMutex s_mutex;
+    quint64 s_lastId = 0;
+    std::deque<Switch> s_switches;
+    QMap<QString, QVector<quint64>> s_histograms;
+
+    QString formatTime(qint64 us)
+    {
+        return QString::number(us / 1000.0, 'f', 3) + QStringLiteral("ms");
+    }
+
+    // Needs to be called with the mutex locked
+    void record(Switch &item, const QString &name,
+                qint64 offset, qint64 duration)
+    {
+        if (offset < 0) {
+            offset = item.timer.nsecsElapsed() / 1000 - qMax(duration, 0ll);
+        }
+
+        item.stages << Stage { name, offset, duration };
+
+        // The histograms show how long after the request
+        // the stage has finished
+        const auto total = (offset + qMax(duration, 0ll)) / 1000;
+
+        auto &histogram = s_histograms[name];
+        if (histogram.isEmpty()) {
+            histogram.fill(0, bucketCount);
+        }
+
+        int bucket = 0;
+        while (bucket < bucketCount - 1 && total >= bucketBounds[bucket]) {
+            ++bucket;
+        }
+
+        ++histogram[bucket];
+    }
+}
+
+quint64 SwitchTrace::begin(const QString &activity)
+{
+    QMutexLocker lock(&s_mutex);
+
+    Switch item;
+    item.id = ++s_lastId;
+    item.activity = activity;
+    item.timer.start();
+
+    s_switches.push_back(item);
+
+    while (s_switches.size() > latestCount) {
+        s_switches.pop_front();
+    }
+
+    record(s_switches.back(), QStringLiteral("requested"), 0, -1);
+
+    return item.id;
+}
+
+void SwitchTrace::mark(quint64 switchId, const QString &stage)
+{
+    if (!switchId) return;
+
+    QMutexLocker lock(&s_mutex);
+
+    // The switches are ordered by their ids, the ones
+    // that are still being marked are at the end
+    for (auto it = s_switches.rbegin(); it != s_switches.rend(); ++it) {
+        if (it->id == switchId) {
+            record(*it, stage, -1, -1);
+            return;
+        }
+    }
+}
+
+SwitchTrace::Handler::Handler(const QString &activity, const QString &name)
+    : m_activity(activity)
+    , m_name(name)
+{
+    m_timer.start();
+}
+
+SwitchTrace::Handler::~Handler()
+{
+    const auto duration = m_timer.nsecsElapsed() / 1000;
+
+    QMutexLocker lock(&s_mutex);
+
+    for (auto it = s_switches.rbegin(); it != s_switches.rend(); ++it) {
+        if (it->activity != m_activity) continue;
+
+        if (it->timer.nsecsElapsed() / 1000 - duration <= maximumAge) {
+            record(*it, m_name, -1, duration);
+        }
+
+        return;
+    }
+}
+
+quint64 SwitchTrace::switches()
+{
+    QMutexLocker lock(&s_mutex);
+    return s_lastId;
+}
+
+QStringList SwitchTrace::latest()
+{
+    QMutexLocker lock(&s_mutex);
+
+    QStringList result;
+
+    for (const auto &item: s_switches) {
+        QStringList stages;
+
+        for (const auto &stage: item.stages) {
+            stages << stage.name + QStringLiteral(" +") + formatTime(stage.offset)
+                      + (stage.duration < 0 ? QString()
+                             : QStringLiteral(" (") + formatTime(stage.duration)
+                                   + QStringLiteral(")"));
+        }
+
+        result << QStringLiteral("#%1 %2: %3")
+                      .arg(item.id)
+                      .arg(item.activity)
+                      .arg(stages.join(QStringLiteral(", ")));
+    }
+
+    return result;
+}
+
+QStringList SwitchTrace::histograms()
+{
+    QMutexLocker lock(&s_mutex);
+
+    QStringList result;
+
+    for (auto it = s_histograms.cbegin(); it != s_histograms.cend(); ++it) {
+        QStringList buckets;
+
+        for (int bucket = 0; bucket < bucketCount; ++bucket) {
+            const auto count = it.value()[bucket];
+            if (!count) continue;
+
+            buckets << (bucket < bucketCount - 1
+                            ? QStringLiteral("<%1ms: %2").arg(bucketBounds[bucket])
+                            : QStringLiteral(">=%1ms: %2").arg(bucketBounds[bucket - 1]))
+                           .arg(count);
+        }
+
+        result << it.key() + QStringLiteral(": ") + buckets.join(QStringLiteral(", "));
+    }
+
+    return result;
+}
@@ -0,0 +1,86 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SWITCH_TRACE_H
+#define SWITCH_TRACE_H
+
+#include "kactivitymanagerd_plugin_export.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QString>
+#include <QStringList>
+
+
+/**
+ * Records how long the different stages of an activity switch take,
+ * from the request, through the session manager and kwin, to the
+ * plugins that react to the change of the current activity.
+ *
+ * The stages are marked with the id of the switch that begin()
+ * returns, the code that marks them needs to pass it along. The
+ * handlers only react to the change of the current activity, they
+ * are attached to the latest switch to the activity.
+ */
+class KACTIVITYMANAGERD_PLUGIN_EXPORT SwitchTrace {
+public:
+    /**
+     * Starts tracing a new switch to the specified activity
+     * @returns the id of the switch
+     */
+    static quint64 begin(const QString &activity);
+
+    /**
+     * Records that the switch has reached the specified stage.
+     * Does nothing if the id is zero, which stands for the requests
+     * that are not a part of a switch
+     */
+    static void mark(quint64 switchId, const QString &stage);
+
+    /**
+     * Records when a handler of the switch has started,
+     * and how long it took to finish
+     */
+    class KACTIVITYMANAGERD_PLUGIN_EXPORT Handler {
+    public:
+        Handler(const QString &activity, const QString &name);
+        ~Handler();
+
+    private:
+        const QString m_activity;
+        const QString m_name;
+        QElapsedTimer m_timer;
+    };
+
+    static quint64 switches();
+
+    /**
+     * @returns the latest switches, one line per switch
+     */
+    static QStringList latest();
+
+    /**
+     * @returns the latency histograms for the stages,
+     * one line per stage
+     */
+    static QStringList histograms();
+};
+
+#endif // SWITCH_TRACE_H
@@ -0,0 +1,127 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QDBusConnection>
+#include <QStandardPaths>
+#include <QtTest>
+
+// STL
+#include <memory>
+
+// Local
+#include "Activities.h"
+#include "TestActivities.h"
+
+
+/**
+ * ListActivitiesWithInformation with 500 activities, when nothing
+ * has changed since the previous call, and when one activity has
+ * been changed before each of the calls
+ */
+class ActivitiesInformationBenchmark : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void listUnchanged();
+    void listAfterChange();
+    void informationUnchanged();
+
+private:
+    std::unique_ptr<Activities> m_activities;
+    QStringList m_ids;
+};
+
+static const int activitiesCount = 500;
+
+void ActivitiesInformationBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        QSKIP("The Activities module needs a session bus");
+    }
+
+    m_ids = TestActivities::create(activitiesCount);
+    m_activities.reset(new Activities());
+
+    QCOMPARE(m_activities->ListActivities().size(), activitiesCount);
+}
+
+void ActivitiesInformationBenchmark::cleanupTestCase()
+{
+    m_activities.reset();
+    TestActivities::clear();
+}
+
+void ActivitiesInformationBenchmark::listUnchanged()
+{
+    ActivityInfoList list;
+
+    QBENCHMARK {
+        list = m_activities->ListActivitiesWithInformation();
+    }
+
+    QCOMPARE(list.size(), activitiesCount);
+}
+
+void ActivitiesInformationBenchmark::listAfterChange()
+{
+    ActivityInfoList list;
+    int changes = 0;
+
+    QBENCHMARK {
+        // Every pass over the activities sets a different icon,
+        // so that the setter never skips the change
+        const auto &activity = m_ids[changes % activitiesCount];
+        const bool oddPass = (changes++ / activitiesCount) % 2;
+
+        m_activities->SetActivityIcon(
+            activity, oddPass ? QStringLiteral("preferences-activities")
+                               : QStringLiteral("activities"));
+
+        list = m_activities->ListActivitiesWithInformation();
+    }
+
+    QCOMPARE(list.size(), activitiesCount);
+
+    const auto changed = m_ids[(changes - 1) % activitiesCount];
+    QCOMPARE(m_activities->ActivityInformation(changed).icon,
+             m_activities->ActivityIcon(changed));
+}
+
+void ActivitiesInformationBenchmark::informationUnchanged()
+{
+    const auto &activity = m_ids[activitiesCount / 2];
+    ActivityInfo info;
+
+    QBENCHMARK {
+        info = m_activities->ActivityInformation(activity);
+    }
+
+    QCOMPARE(info.id, activity);
+}
+
+QTEST_GUILESS_MAIN(ActivitiesInformationBenchmark)
+
+#include "ActivitiesInformationBenchmark.moc"
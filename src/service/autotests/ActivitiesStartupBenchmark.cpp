@@ -0,0 +1,128 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QDBusConnection>
+#include <QStandardPaths>
+#include <QtTest>
+
+// STL
+#include <memory>
+
+// Local
+#include "Activities.h"
+#include "TestActivities.h"
+
+
+/**
+ * Times the construction of the Activities module with 1000
+ * activities, when they are loaded from the store, and when
+ * they need to be imported from the configuration file
+ */
+class ActivitiesStartupBenchmark : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void startup_data();
+    void startup();
+};
+
+namespace {
+    enum Source {
+        StoreOnly,
+        StoreAndConfig,
+        ConfigOnly
+    };
+}
+
+Q_DECLARE_METATYPE(Source)
+
+void ActivitiesStartupBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        QSKIP("The Activities module needs a session bus");
+    }
+}
+
+void ActivitiesStartupBenchmark::cleanupTestCase()
+{
+    TestActivities::clear();
+}
+
+void ActivitiesStartupBenchmark::startup_data()
+{
+    QTest::addColumn<int>("count");
+    QTest::addColumn<Source>("source");
+
+    QTest::newRow("100 activities, store") << 100 << StoreOnly;
+    QTest::newRow("1000 activities, store") << 1000 << StoreOnly;
+    QTest::newRow("1000 activities, store and config") << 1000 << StoreAndConfig;
+    QTest::newRow("1000 activities, config") << 1000 << ConfigOnly;
+}
+
+void ActivitiesStartupBenchmark::startup()
+{
+    QFETCH(int, count);
+    QFETCH(Source, source);
+
+    const auto data = TestActivities::generate(count);
+
+    TestActivities::clear();
+
+    // The config file needs to be written first,
+    // otherwise it would be considered newer than the store
+    if (source != StoreOnly) {
+        TestActivities::writeConfig(data);
+    }
+
+    if (source != ConfigOnly) {
+        QVERIFY(ActivityStore().save(data));
+    }
+
+    std::unique_ptr<Activities> activities;
+
+    // Only the first start is interesting, after it the
+    // store would exist even for the config-only case
+    QBENCHMARK_ONCE {
+        activities.reset(new Activities());
+    }
+
+    QCOMPARE(activities->ListActivities().size(), count);
+    QCOMPARE(activities->CurrentActivity(), data.currentActivity);
+
+    const auto name = activities->ActivityName(data.currentActivity);
+    QCOMPARE(name, data.activities[data.currentActivity].name);
+
+    // Saves the pending changes, if any
+    activities.reset();
+
+    if (source == ConfigOnly) {
+        QVERIFY(ActivityStore().isNewerThanConfig());
+    }
+}
+
+QTEST_GUILESS_MAIN(ActivitiesStartupBenchmark)
+
+#include "ActivitiesStartupBenchmark.moc"
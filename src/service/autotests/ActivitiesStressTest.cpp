@@ -0,0 +1,238 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QDBusConnection>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtTest>
+
+// STL
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Local
+#include "Activities.h"
+#include "ActivitiesSnapshot.h"
+#include "TestActivities.h"
+
+
+/**
+ * Switches the activities in the main thread while other threads
+ * read the current activity and the activity information, and checks
+ * that the readers never see an inconsistent state.
+ *
+ * The test is most useful when built with ThreadSanitizer,
+ * by configuring with -DECM_ENABLE_SANITIZERS='thread'
+ */
+class ActivitiesStressTest : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void switchWhileReading();
+
+private:
+    std::unique_ptr<Activities> m_activities;
+    QStringList m_ids;
+};
+
+static const int activitiesCount = 50;
+static const int switchesCount = 20000;
+
+namespace {
+
+class Reader : public QThread {
+public:
+    Reader(const Activities *activities, const QStringList &ids,
+           const std::atomic<bool> &stopped)
+        : activities(activities)
+        , ids(ids)
+        , stopped(stopped)
+        , reads(0)
+    {
+    }
+
+    void run() override
+    {
+        quint64 lastVersion = 0;
+
+        while (!stopped) {
+            const auto snapshot = ActivitiesSnapshot::current();
+
+            if (snapshot->version < lastVersion) {
+                fail(QStringLiteral("The snapshot version went back from %1 to %2")
+                         .arg(lastVersion).arg(snapshot->version));
+            }
+            lastVersion = snapshot->version;
+
+            if (!ids.contains(snapshot->currentActivity)
+                    || snapshot->state(snapshot->currentActivity) != Activities::Running) {
+                fail(QStringLiteral("The snapshot has an invalid current activity: ")
+                     + snapshot->currentActivity);
+            }
+
+            if (snapshot->activities.size() != ids.size()) {
+                fail(QStringLiteral("The snapshot has %1 activities")
+                         .arg(snapshot->activities.size()));
+            }
+
+            const auto current = activities->CurrentActivity();
+
+            if (!ids.contains(current)) {
+                fail(QStringLiteral("Invalid current activity: ") + current);
+            }
+
+            // The information is rebuilt while the activities are being
+            // switched and renamed, these are the slower reads
+            if (reads % 16 == 0) {
+                const auto list = activities->ListActivitiesWithInformation();
+
+                if (list.size() != ids.size()) {
+                    fail(QStringLiteral("The information has %1 activities")
+                             .arg(list.size()));
+                }
+
+                const auto info = activities->ActivityInformation(current);
+
+                if (info.id != current || info.name.isEmpty()) {
+                    fail(QStringLiteral("Invalid information for ") + current);
+                }
+            }
+
+            ++reads;
+        }
+    }
+
+    QStringList errors() const
+    {
+        QMutexLocker lock(&errorsMutex);
+        return errorList;
+    }
+
+    const Activities *const activities;
+    const QStringList ids;
+    const std::atomic<bool> &stopped;
+    quint64 reads;
+
+private:
+    void fail(const QString &error)
+    {
+        QMutexLocker lock(&errorsMutex);
+
+        // The first few are enough to know what went wrong
+        if (errorList.size() < 10) {
+            errorList << error;
+        }
+    }
+
+    mutable QMutex errorsMutex;
+    QStringList errorList;
+};
+
+} // namespace
+
+void ActivitiesStressTest::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        QSKIP("The Activities module needs a session bus");
+    }
+
+    m_ids = TestActivities::create(activitiesCount);
+    m_activities.reset(new Activities());
+
+    QCOMPARE(m_activities->ListActivities(Activities::Running).size(),
+             activitiesCount);
+}
+
+void ActivitiesStressTest::cleanupTestCase()
+{
+    m_activities.reset();
+    TestActivities::clear();
+}
+
+void ActivitiesStressTest::switchWhileReading()
+{
+    std::atomic<bool> stopped(false);
+
+    std::vector<std::unique_ptr<Reader>> readers;
+    const int readersCount = qMax(2, QThread::idealThreadCount() - 1);
+
+    for (int i = 0; i < readersCount; ++i) {
+        readers.emplace_back(new Reader(m_activities.get(), m_ids, stopped));
+        readers.back()->start();
+    }
+
+    // Not verifying in the loop, the readers need to be stopped first
+    int failedSwitches = 0;
+
+    QBENCHMARK_ONCE {
+        for (int i = 0; i < switchesCount; ++i) {
+            const auto &activity = m_ids[i % activitiesCount];
+
+            if (!m_activities->SetCurrentActivity(activity)) {
+                ++failedSwitches;
+            }
+
+            // Renaming makes the readers rebuild the information
+            if (i % 10 == 0) {
+                m_activities->SetActivityName(
+                    activity, QStringLiteral("Activity %1 renamed %2")
+                                  .arg(i % activitiesCount).arg(i));
+            }
+
+            if (i % 100 == 0) {
+                QCoreApplication::processEvents();
+            }
+        }
+    }
+
+    stopped = true;
+
+    quint64 reads = 0;
+
+    for (const auto &reader: readers) {
+        QVERIFY(reader->wait(10000));
+
+        const auto errors = reader->errors();
+        QVERIFY2(errors.isEmpty(), qPrintable(errors.join(QLatin1Char('\n'))));
+
+        reads += reader->reads;
+    }
+
+    qDebug() << "Reads while switching:" << reads
+             << "in" << readersCount << "threads";
+
+    QCOMPARE(failedSwitches, 0);
+    QVERIFY(reads > 0);
+    QCOMPARE(ActivitiesSnapshot::current()->currentActivity,
+             m_ids[(switchesCount - 1) % activitiesCount]);
+}
+
+QTEST_GUILESS_MAIN(ActivitiesStressTest)
+
+#include "ActivitiesStressTest.moc"
@@ -0,0 +1,166 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QDBusConnection>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QtTest>
+
+// STL
+#include <memory>
+
+// Local
+#include "Activities.h"
+#include "TestActivities.h"
+
+
+/**
+ * Stops and starts an activity, and changes the activities, as fast
+ * as possible. Reports how many of the scheduled saves were written,
+ * the writer needs to coalesce them instead of writing each one.
+ *
+ * The sessions are started and stopped without kwin, the test
+ * is meant to be run on a session bus of its own.
+ */
+class ActivityStateBenchmark : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void toggleState();
+    void rapidChanges();
+
+private:
+    bool waitForState(const QString &activity, int state) const;
+    quint64 persistence(const QString &counter) const;
+
+    std::unique_ptr<Activities> m_activities;
+    QStringList m_ids;
+};
+
+static const int activitiesCount = 20;
+
+bool ActivityStateBenchmark::waitForState(const QString &activity, int state) const
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Not using QTest::qWait, it would sleep for much longer
+    // than the state change takes
+    while (m_activities->ActivityState(activity) != state) {
+        if (timer.elapsed() > 5000) {
+            return false;
+        }
+
+        QCoreApplication::processEvents();
+    }
+
+    return true;
+}
+
+quint64 ActivityStateBenchmark::persistence(const QString &counter) const
+{
+    return m_activities->featureValue({ QStringLiteral("persistence"), counter })
+        .variant().toULongLong();
+}
+
+void ActivityStateBenchmark::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+
+    if (!QDBusConnection::sessionBus().isConnected()) {
+        QSKIP("The Activities module needs a session bus");
+    }
+
+    m_ids = TestActivities::create(activitiesCount);
+    m_activities.reset(new Activities());
+
+    QCOMPARE(m_activities->ListActivities(Activities::Running).size(),
+             activitiesCount);
+}
+
+void ActivityStateBenchmark::cleanupTestCase()
+{
+    m_activities.reset();
+    TestActivities::clear();
+}
+
+void ActivityStateBenchmark::toggleState()
+{
+    // Not the current activity, that one can not be stopped
+    auto activity = m_ids[0];
+    if (activity == m_activities->CurrentActivity()) {
+        activity = m_ids[1];
+    }
+
+    const auto scheduled = persistence(QStringLiteral("scheduled"));
+    const auto writes = persistence(QStringLiteral("writes"));
+    int toggles = 0;
+
+    QBENCHMARK {
+        m_activities->StopActivity(activity);
+        QVERIFY(waitForState(activity, Activities::Stopped));
+
+        m_activities->StartActivity(activity);
+        QVERIFY(waitForState(activity, Activities::Running));
+
+        ++toggles;
+    }
+
+    qDebug() << "Toggles:" << toggles
+             << "scheduled saves:" << persistence(QStringLiteral("scheduled")) - scheduled
+             << "written:" << persistence(QStringLiteral("writes")) - writes;
+}
+
+void ActivityStateBenchmark::rapidChanges()
+{
+    const auto scheduled = persistence(QStringLiteral("scheduled"));
+    const auto writes = persistence(QStringLiteral("writes"));
+    int changes = 0;
+
+    QBENCHMARK {
+        for (int i = 0; i < 100; ++i, ++changes) {
+            m_activities->SetActivityName(
+                m_ids[changes % activitiesCount],
+                QStringLiteral("Activity renamed %1").arg(changes));
+        }
+
+        QCoreApplication::processEvents();
+    }
+
+    const auto scheduledNow = persistence(QStringLiteral("scheduled")) - scheduled;
+    const auto writesNow = persistence(QStringLiteral("writes")) - writes;
+
+    qDebug() << "Changes:" << changes
+             << "scheduled saves:" << scheduledNow
+             << "written:" << writesNow;
+
+    // Every change schedules a save, but they are written
+    // only after the quiet period or the maximum delay
+    QVERIFY(scheduledNow >= (quint64)changes);
+    QVERIFY(writesNow < scheduledNow);
+}
+
+QTEST_GUILESS_MAIN(ActivityStateBenchmark)
+
+#include "ActivityStateBenchmark.moc"
@@ -0,0 +1,127 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+#include <QtTest>
+
+// Local
+#include "plugins/sqlite/CanonicalPathCache.h"
+
+
+/**
+ * Compares the cached canonical path lookups with resolving the
+ * path each time, and checks that the cache notices the removed files
+ */
+class CanonicalPathCacheBenchmark : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void cached();
+    void uncached();
+    void removedFile();
+
+private:
+    QTemporaryDir m_dir;
+    QStringList m_paths;
+};
+
+static const int filesCount = 1000;
+
+void CanonicalPathCacheBenchmark::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    // A few levels of directories, and the paths that are not
+    // canonical, like the ones that the applications report
+    for (int i = 0; i < filesCount; ++i) {
+        const auto directory = QStringLiteral("%1/level1/level2-%2/level3")
+                                   .arg(m_dir.path()).arg(i % 10);
+        QVERIFY(QDir().mkpath(directory));
+
+        const auto fileName = QStringLiteral("%1/file%2.txt").arg(directory).arg(i);
+
+        QFile file(fileName);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+
+        m_paths << QStringLiteral("%1/level1/./level2-%2/../level2-%2/level3/file%3.txt")
+                       .arg(m_dir.path()).arg(i % 10).arg(i);
+    }
+}
+
+void CanonicalPathCacheBenchmark::cached()
+{
+    CanonicalPathCache cache;
+    cache.setCapacity(filesCount);
+
+    // Filling the cache first
+    for (const auto &path: m_paths) {
+        QVERIFY(!cache.canonicalPath(path).isEmpty());
+    }
+
+    const auto misses = cache.misses();
+
+    QBENCHMARK {
+        for (const auto &path: m_paths) {
+            cache.canonicalPath(path);
+        }
+    }
+
+    QCOMPARE(cache.misses(), misses);
+}
+
+void CanonicalPathCacheBenchmark::uncached()
+{
+    int found = 0;
+
+    QBENCHMARK {
+        for (const auto &path: m_paths) {
+            found += !QFileInfo(path).canonicalFilePath().isEmpty();
+        }
+    }
+
+    QVERIFY(found > 0);
+}
+
+void CanonicalPathCacheBenchmark::removedFile()
+{
+    CanonicalPathCache cache;
+
+    const auto path = m_paths.last();
+    const auto canonicalPath = cache.canonicalPath(path);
+
+    QCOMPARE(canonicalPath, QFileInfo(path).canonicalFilePath());
+    QCOMPARE(cache.canonicalPath(path), canonicalPath);
+
+    QVERIFY(QFile::remove(canonicalPath));
+
+    // The directory watcher reports the change through the event loop.
+    // Without it, the entry is checked again after ten seconds
+    QTRY_VERIFY_WITH_TIMEOUT(cache.canonicalPath(path).isEmpty(), 15000);
+}
+
+QTEST_GUILESS_MAIN(CanonicalPathCacheBenchmark)
+
+#include "CanonicalPathCacheBenchmark.moc"
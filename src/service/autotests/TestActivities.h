@@ -0,0 +1,118 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef AUTOTESTS_TEST_ACTIVITIES_H
+#define AUTOTESTS_TEST_ACTIVITIES_H
+
+// Qt
+#include <QFile>
+#include <QStandardPaths>
+#include <QStringList>
+#include <QUuid>
+
+// KDE
+#include <kconfig.h>
+
+// Local
+#include "ActivityStore.h"
+
+
+/**
+ * Helpers for the tests that run the Activities module with many
+ * activities. QStandardPaths test mode needs to be enabled before
+ * they are used, so that the activities of the user are not touched.
+ */
+namespace TestActivities {
+
+inline QString configFilePath()
+{
+    // Same location that ActivityStore::isNewerThanConfig checks
+    return QStandardPaths::writableLocation(QStandardPaths::ConfigLocation)
+           + QLatin1Char('/') + ActivityStore::configFileName();
+}
+
+/**
+ * Removes the store and the configuration file
+ */
+inline void clear()
+{
+    QFile::remove(ActivityStore::defaultFileName());
+    QFile::remove(configFilePath());
+}
+
+/**
+ * Generates the data for the specified number of running activities,
+ * the first one is the current activity
+ */
+inline ActivityStore::Data generate(int count)
+{
+    ActivityStore::Data data;
+    data.activities.reserve(count);
+
+    QString first;
+
+    for (int i = 0; i < count; ++i) {
+        const auto id = QUuid::createUuid().toString().mid(1, 36);
+
+        data.activities[id] = {
+            QStringLiteral("Activity %1").arg(i),
+            QStringLiteral("Description of the activity %1").arg(i),
+            QStringLiteral("preferences-activities")
+        };
+
+        if (first.isEmpty()) {
+            first = id;
+        }
+    }
+
+    data.currentActivity = first;
+
+    return data;
+}
+
+/**
+ * Replaces the activities with the specified number of running ones.
+ * Only the store is written, so that the Activities module does not
+ * need to parse the configuration file on startup.
+ * @returns the ids of the activities
+ */
+inline QStringList create(int count)
+{
+    const auto data = generate(count);
+
+    clear();
+    ActivityStore().save(data);
+
+    return data.activities.keys();
+}
+
+/**
+ * Writes the activities to the configuration file, the way
+ * the older versions of the service saved them
+ */
+inline void writeConfig(const ActivityStore::Data &data)
+{
+    KConfig config(ActivityStore::configFileName());
+    ActivityStore::exportConfig(config, data);
+}
+
+} // namespace TestActivities
+
+#endif // AUTOTESTS_TEST_ACTIVITIES_H
@@ -0,0 +1,226 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or
+ *   modify it under the terms of the GNU General Public License as
+ *   published by the Free Software Foundation; either version 2 of
+ *   the License or (at your option) version 3 or any later version
+ *   accepted by the membership of KDE e.V. (or its successor approved
+ *   by the membership of KDE e.V.), which shall act as a proxy
+ *   defined in Section 14 of version 3 of the license.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Qt
+#include <QRegExp>
+#include <QtTest>
+
+// Local
+#include "plugins/sqlite/UrlFilterMatcher.h"
+#include <common/database/Database.h>
+
+
+/**
+ * Compares the compiled URL filter matcher with the list of regular
+ * expressions that acceptedEvent used before, for the default
+ * url-filters and for the long lists of user-defined filters.
+ */
+class UrlFilterMatcherBenchmark : public QObject {
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void matchesLikeRegex_data();
+    void matchesLikeRegex();
+
+    void compiled_data();
+    void compiled();
+
+    void regexList_data();
+    void regexList();
+
+private:
+    void addFilterSets();
+
+    QStringList m_uris;
+};
+
+namespace {
+    QStringList defaultFilters()
+    {
+        return {
+            QStringLiteral("about:*"),
+            QStringLiteral("*/.*"),
+            QStringLiteral("/"),
+            QStringLiteral("/tmp/*")
+        };
+    }
+
+    // Defaults, and then the count filters in all of the shapes
+    // that the matcher distinguishes
+    QStringList generatedFilters(int count)
+    {
+        auto result = defaultFilters();
+
+        for (int i = 0; result.size() < count; ++i) {
+            switch (i % 5) {
+                case 0:
+                    result << QStringLiteral("/home/user/project%1/*").arg(i);
+                    break;
+                case 1:
+                    result << QStringLiteral("*.extension%1").arg(i);
+                    break;
+                case 2:
+                    result << QStringLiteral("*/directory%1/*").arg(i);
+                    break;
+                case 3:
+                    result << QStringLiteral("/home/user/file%1.txt").arg(i);
+                    break;
+                default:
+                    result << QStringLiteral("/home/*/cache%1/*.tmp").arg(i);
+                    break;
+            }
+        }
+
+        return result;
+    }
+
+    bool matchesAnyRegex(const QList<QRegExp> &filters, const QString &uri)
+    {
+        for (const auto &filter: filters) {
+            if (filter.exactMatch(uri)) {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
+
+void UrlFilterMatcherBenchmark::initTestCase()
+{
+    // Mostly the URIs that pass the filters, like the real events do
+    for (int i = 0; i < 1000; ++i) {
+        m_uris << QStringLiteral("/home/user/Documents/report%1.odt").arg(i)
+               << QStringLiteral("/home/user/src/project%1/main.cpp").arg(i % 50)
+               << QStringLiteral("https://www.kde.org/page%1.html").arg(i)
+               << QStringLiteral("applications:org.kde.app%1.desktop").arg(i);
+
+        if (i % 10 == 0) {
+            m_uris << QStringLiteral("/home/user/.config/file%1").arg(i)
+                   << QStringLiteral("/tmp/download%1").arg(i)
+                   << QStringLiteral("about:page%1").arg(i);
+        }
+    }
+
+    m_uris << QStringLiteral("/")
+           << QStringLiteral("/home/user/file3.txt")
+           << QStringLiteral("/home/user/a.extension1")
+           << QStringLiteral("/home/user/cache4/x.tmp")
+           << QStringLiteral("/home/user/directory2/file")
+           << QString();
+}
+
+void UrlFilterMatcherBenchmark::addFilterSets()
+{
+    QTest::addColumn<QStringList>("filters");
+
+    QTest::newRow("defaults") << defaultFilters();
+    QTest::newRow("100 filters") << generatedFilters(100);
+    QTest::newRow("1000 filters") << generatedFilters(1000);
+}
+
+void UrlFilterMatcherBenchmark::matchesLikeRegex_data()
+{
+    addFilterSets();
+
+    // The regular expression characters and the escaped stars
+    // need to be matched literally
+    QTest::newRow("escaped") << QStringList {
+        QStringLiteral("/home/user/\\*literal*"),
+        QStringLiteral("*\\\\backslash"),
+        QStringLiteral("/home/user/a.b*")
+    };
+}
+
+void UrlFilterMatcherBenchmark::matchesLikeRegex()
+{
+    QFETCH(QStringList, filters);
+
+    const UrlFilterMatcher matcher(filters);
+
+    QList<QRegExp> regexes;
+    for (const auto &filter: filters) {
+        regexes << Common::starPatternToRegex(filter);
+    }
+
+    auto uris = m_uris;
+    uris << QStringLiteral("/home/user/*literal-and-more")
+         << QStringLiteral("/home/user/\\*literal-and-more")
+         << QStringLiteral("/home/user/\\literal")
+         << QStringLiteral("/path/\\backslash")
+         << QStringLiteral("/home/user/a.bc")
+         << QStringLiteral("/home/user/aXbc");
+
+    for (const auto &uri: uris) {
+        QCOMPARE(matcher.matches(uri), matchesAnyRegex(regexes, uri));
+    }
+}
+
+void UrlFilterMatcherBenchmark::compiled_data()
+{
+    addFilterSets();
+}
+
+void UrlFilterMatcherBenchmark::compiled()
+{
+    QFETCH(QStringList, filters);
+
+    const UrlFilterMatcher matcher(filters);
+    int matched = 0;
+
+    QBENCHMARK {
+        for (const auto &uri: m_uris) {
+            matched += matcher.matches(uri);
+        }
+    }
+
+    QVERIFY(matched > 0);
+}
+
+void UrlFilterMatcherBenchmark::regexList_data()
+{
+    addFilterSets();
+}
+
+void UrlFilterMatcherBenchmark::regexList()
+{
+    QFETCH(QStringList, filters);
+
+    QList<QRegExp> regexes;
+    for (const auto &filter: filters) {
+        regexes << Common::starPatternToRegex(filter);
+    }
+
+    int matched = 0;
+
+    QBENCHMARK {
+        for (const auto &uri: m_uris) {
+            matched += matchesAnyRegex(regexes, uri);
+        }
+    }
+
+    QVERIFY(matched > 0);
+}
+
+QTEST_GUILESS_MAIN(UrlFilterMatcherBenchmark)
+
+#include "UrlFilterMatcherBenchmark.moc"
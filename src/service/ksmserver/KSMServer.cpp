@@ -29,6 +29,7 @@
 #include <QDBusConnectionInterface>
 #include <QDBusPendingReply>
 #include <QDBusPendingCallWatcher>
+#include <QMutexLocker>
 
 // KDE
 #include <kdbusconnectionpool.h>
@@ -38,15 +39,29 @@
 
 // Local
 #include "DebugActivities.h"
+#include "SwitchTrace.h"
 
 #define KWIN_SERVICE QStringLiteral("org.kde.KWin")
 
+namespace {
+    // Independent activities are started and stopped in parallel,
+    // but we do not want to flood kwin with calls
+    const int maximumCallsInFlight = 4;
+
+    // Starting or stopping a session should not take longer than this.
+    // If it does, we treat it as if kwin has not replied at all
+    const int callTimeout = 5000; // ms
+}
+
 KSMServer::Private::Private(KSMServer *parent)
     : serviceWatcher(new QDBusServiceWatcher(this))
     , kwin(nullptr)
     , processing(false)
+    , callsInFlight(0)
     , q(parent)
 {
+    statistics = KSMServer::Statistics { 0, 0, 0, 0, 0, 0, 0 };
+
     serviceWatcher->setConnection(KDBusConnectionPool::threadConnection());
     serviceWatcher->addWatchedService(KWIN_SERVICE);
 
@@ -81,6 +96,7 @@ void KSMServer::Private::serviceOwnerChanged(const QString &service,
             // otherwise delete the object
             if (kwin->isValid()) {
                 kwin->setParent(this);
+                kwin->setTimeout(callTimeout);
 
             } else {
                 delete kwin;
@@ -100,137 +116,231 @@ KSMServer::~KSMServer()
 {
 }
 
-void KSMServer::startActivitySession(const QString &activity)
+KSMServer::Statistics KSMServer::statistics() const
 {
-    d->processLater(activity, true);
+    QMutexLocker lock(&d->statisticsMutex);
+    return d->statistics;
+}
+
+void KSMServer::startActivitySession(const QString &activity, quint64 switchId)
+{
+    d->processLater(activity, true, switchId);
 }
 
 void KSMServer::stopActivitySession(const QString &activity)
 {
-    d->processLater(activity, false);
+    d->processLater(activity, false, 0);
 }
 
-void KSMServer::Private::processLater(const QString &activity, bool start)
+void KSMServer::Private::processLater(const QString &activity, bool start,
+                                      quint64 switchId)
 {
-    if (kwin) {
-        for (const auto &item: queue) {
-            if (item.first == activity) {
-                return;
-            }
+    const auto operation = start ? Start : Stop;
+
+    {
+        QMutexLocker lock(&statisticsMutex);
+        ++statistics.requests;
+    }
+
+    SwitchTrace::mark(switchId, QStringLiteral("ksmserver-queued"));
+
+    auto &session = sessions[activity];
+
+    if (session.pending == operation) {
+        // Already waiting to be processed
+        return;
+    }
+
+    if (session.pending != None) {
+        // The opposite operation has not been sent to kwin yet,
+        // the two requests cancel each other. The activity is left
+        // in the state it was in before the first request.
+        {
+            QMutexLocker lock(&statisticsMutex);
+            statistics.cancelled += 2;
         }
 
-        queue << qMakePair(activity, start);
+        session.pending = None;
+        session.pendingSwitch = 0;
 
-        if (!processing) {
-            processing = true;
-            QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+        if (session.inFlight != None) {
+            // The call in flight is the same as this request,
+            // its result is reported when kwin replies
+            return;
         }
-    } else {
-        // We don't have kwin. No way to invoke the session stuff
-        subSessionSendEvent(start ? KSMServer::Started
-                                  : KSMServer::Stopped);
+
+        sessions.remove(activity);
+
+        // Nothing has been sent to kwin, this is not counted
+        // in the completed calls nor in their latency
+        emit q->activitySessionStateChanged(
+            activity, start ? KSMServer::Started : KSMServer::Stopped);
+        return;
+    }
+
+    if (session.inFlight == operation) {
+        // The same operation is already in progress
+        return;
+    }
+
+    session.pending = operation;
+    session.pendingSince.start();
+    session.pendingSwitch = switchId;
+
+    if (!processing) {
+        processing = true;
+        QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
     }
 }
 
 void KSMServer::Private::process()
 {
-    // If the queue is empty, we have nothing more to do
-    if (queue.isEmpty()) {
-        processing = false;
-        return;
-    }
+    processing = false;
+
+    // Sending the calls for all the activities that have a pending
+    // request and no call in flight, as long as we are not over the limit
+    for (auto it = sessions.begin(); it != sessions.end()
+                                     && callsInFlight < maximumCallsInFlight; ) {
+        auto &session = it.value();
+
+        if (session.pending == None || session.inFlight != None) {
+            ++it;
+            continue;
+        }
+
+        const auto activity = it.key();
 
-    const auto item = queue.takeFirst();
-    processingActivity = item.first;
+        if (!kwin) {
+            // We don't have kwin. No way to invoke the session stuff
+            qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: No kwin, marking activity as: "
+                                         << (session.pending == Start);
 
-    makeRunning(item.second);
+            const auto requested = session.pendingSince;
+            const auto event = session.pending == Start ? KSMServer::Started
+                                                        : KSMServer::Stopped;
+            it = sessions.erase(it);
 
-    // Calling process again for the rest of the list
-    QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+            subSessionSendEvent(activity, event, requested);
+            continue;
+        }
+
+        makeRunning(activity, session);
+        ++it;
+    }
 }
 
-void KSMServer::Private::makeRunning(bool value)
+void KSMServer::Private::makeRunning(const QString &activity, Session &session)
 {
-    if (!kwin) {
-        qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: No kwin, marking activity as: " << value;
-        subSessionSendEvent(value ? KSMServer::Started : KSMServer::Stopped);
-        return;
+    const bool value = (session.pending == Start);
+
+    session.inFlight = session.pending;
+    session.inFlightSince = session.pendingSince;
+    session.inFlightSwitch = session.pendingSwitch;
+    session.pending = None;
+    session.pendingSwitch = 0;
+
+    ++callsInFlight;
+
+    {
+        QMutexLocker lock(&statisticsMutex);
+        statistics.callsInFlight = callsInFlight;
     }
 
+    SwitchTrace::mark(session.inFlightSwitch, QStringLiteral("kwin-called"));
+
     const auto call = kwin->asyncCall(
         value ? QLatin1String("startActivity") : QLatin1String("stopActivity"),
-        processingActivity);
+        activity);
 
     const auto watcher = new QDBusPendingCallWatcher(call, this);
 
-    qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Telling kwin to start/stop activity : " << processingActivity << value;
+    qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Telling kwin to start/stop activity : " << activity << value;
     QObject::connect(
-        watcher, SIGNAL(finished(QDBusPendingCallWatcher *)),
-        this,
-        value
-            ? SLOT(startCallFinished(QDBusPendingCallWatcher *))
-            : SLOT(stopCallFinished(QDBusPendingCallWatcher *)));
+        watcher, &QDBusPendingCallWatcher::finished,
+        this, [this, activity] (QDBusPendingCallWatcher *call) {
+            callFinished(activity, call);
+        });
 }
 
-void KSMServer::Private::startCallFinished(QDBusPendingCallWatcher *call)
+void KSMServer::Private::callFinished(const QString &activity,
+                                      QDBusPendingCallWatcher *call)
 {
-    qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Start call is finished";
-    QDBusPendingReply<bool> reply = *call;
+    call->deleteLater();
+    --callsInFlight;
 
-    if (reply.isError()) {
-        qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Error in getting a reply for start, marking as started";
-        subSessionSendEvent(KSMServer::Started);
+    auto &session = sessions[activity];
+    const bool value = (session.inFlight == Start);
+    const auto requested = session.inFlightSince;
+    const auto switchId = session.inFlightSwitch;
 
-    } else {
-        // If we got false, it means something is going on with ksmserver
-        // and it didn't start our activity
-        const auto retval = reply.argumentAt<0>();
+    session.inFlight = None;
+    session.inFlightSwitch = 0;
 
-        if (!retval) {
-            qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Error starting, marking as stopped";
-            subSessionSendEvent(KSMServer::Stopped);
-        } else {
-            qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: All OK starting, marking as starting";
-            subSessionSendEvent(KSMServer::Started);
-        }
-    }
+    qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Start/stop call is finished" << activity << value;
+    QDBusPendingReply<bool> reply = *call;
 
-    call->deleteLater();
-}
+    int event;
 
-void KSMServer::Private::stopCallFinished(QDBusPendingCallWatcher *call)
-{
-    qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Stop call is finished";
-    QDBusPendingReply<bool> reply = *call;
+    SwitchTrace::mark(switchId, QStringLiteral("kwin-replied"));
 
     if (reply.isError()) {
-        qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Error in getting a reply for stop, marking as stopped";
-        subSessionSendEvent(KSMServer::Stopped);
+        qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Error in getting a reply, marking as "
+                                     << (value ? "started" : "stopped")
+                                     << reply.error().message();
+
+        if (reply.error().type() == QDBusError::NoReply
+                || reply.error().type() == QDBusError::Timeout) {
+            QMutexLocker lock(&statisticsMutex);
+            ++statistics.timedOut;
+        }
+
+        event = value ? KSMServer::Started : KSMServer::Stopped;
 
     } else {
         // If we got false, it means something is going on with ksmserver
-        // and it didn't stop our activity
+        // and it didn't start or stop our activity
         const auto retval = reply.argumentAt<0>();
 
-        if (!retval) {
-            qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: Error stopping, marking as started";
-            subSessionSendEvent(KSMServer::FailedToStop);
-        } else {
-            qCDebug(KAMD_LOG_ACTIVITIES) << "Activities KSM: All OK stopping, marking as stopped";
-            subSessionSendEvent(KSMServer::Stopped);
+        event = value ? (retval ? KSMServer::Started : KSMServer::Stopped)
+                      : (retval ? KSMServer::Stopped : KSMServer::FailedToStop);
+    }
+
+    if (session.pending == None) {
+        sessions.remove(activity);
+
+    } else if (!processing) {
+        // The opposite operation has been requested while
+        // this one was in flight
+        processing = true;
+        QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+    }
+
+    // The call slot is freed, other activities might be waiting for it
+    if (!processing) {
+        for (const auto &other: sessions) {
+            if (other.pending != None) {
+                processing = true;
+                QMetaObject::invokeMethod(this, "process", Qt::QueuedConnection);
+                break;
+            }
         }
     }
 
-    call->deleteLater();
+    subSessionSendEvent(activity, event, requested);
 }
 
-void KSMServer::Private::subSessionSendEvent(int event)
+void KSMServer::Private::subSessionSendEvent(const QString &activity, int event,
+                                             const QElapsedTimer &requested)
 {
-    if (processingActivity.isEmpty()) {
-        return;
+    {
+        const quint64 latency = requested.nsecsElapsed() / 1000;
+
+        QMutexLocker lock(&statisticsMutex);
+        ++statistics.completed;
+        statistics.latency += latency;
+        statistics.maxLatency = qMax(statistics.maxLatency, latency);
+        statistics.callsInFlight = callsInFlight;
     }
 
-    emit q->activitySessionStateChanged(processingActivity, event);
-
-    processingActivity.clear();
+    emit q->activitySessionStateChanged(activity, event);
 }
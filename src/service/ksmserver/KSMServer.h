@@ -43,8 +43,27 @@ public:
     explicit KSMServer(QObject *parent = nullptr);
     ~KSMServer() override;
 
+    struct Statistics {
+        quint64 requests;
+        quint64 cancelled;  // opposite requests that cancelled each other
+        quint64 completed;
+        quint64 timedOut;
+        quint64 latency;    // us, total, from the request to the reply
+        quint64 maxLatency; // us
+        int callsInFlight;
+    };
+
+    /**
+     * Can be called from any thread
+     */
+    Statistics statistics() const;
+
 public Q_SLOTS:
-    void startActivitySession(const QString &activity);
+    /**
+     * @param switchId the SwitchTrace id of the activity switch
+     *     that needs the activity to be started, or zero
+     */
+    void startActivitySession(const QString &activity, quint64 switchId = 0);
     void stopActivitySession(const QString &activity);
 
 Q_SIGNALS:
@@ -25,7 +25,9 @@
 #include "KSMServer.h"
 
 // Qt
-#include <QPair>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
 
 // STD
 #include <memory>
@@ -40,26 +42,58 @@ class KSMServer::Private : public QObject {
 public:
     Private(KSMServer *parent);
 
-    void processLater(const QString &activity, bool start);
+    void processLater(const QString &activity, bool start, quint64 switchId);
+
+    mutable QMutex statisticsMutex;
+    KSMServer::Statistics statistics;
 
 private Q_SLOTS:
     void serviceOwnerChanged(const QString &service, const QString &oldOwner, const QString &newOwner);
 
     void process();
-    void makeRunning(bool value);
-
-    void startCallFinished(QDBusPendingCallWatcher *watcher);
-    void stopCallFinished(QDBusPendingCallWatcher *watcher);
-
-    void subSessionSendEvent(int event);
 
 private:
+    enum Operation {
+        None,
+        Start,
+        Stop
+    };
+
+    // Each activity has at most one call to kwin in flight, and
+    // at most one request waiting for it to finish
+    struct Session {
+        Session()
+            : pending(None)
+            , pendingSwitch(0)
+            , inFlight(None)
+            , inFlightSwitch(0)
+        {
+        }
+
+        // The switch ids are used for tracing, zero if
+        // the request is not a part of a switch
+        Operation pending;
+        QElapsedTimer pendingSince;
+        quint64 pendingSwitch;
+
+        Operation inFlight;
+        QElapsedTimer inFlightSince;
+        quint64 inFlightSwitch;
+    };
+
+    void makeRunning(const QString &activity, Session &session);
+
+    void callFinished(const QString &activity, QDBusPendingCallWatcher *call);
+
+    void subSessionSendEvent(const QString &activity, int event,
+                             const QElapsedTimer &requested);
+
     std::unique_ptr<QDBusServiceWatcher> serviceWatcher;
     QDBusInterface *kwin;
 
     bool processing;
-    QString processingActivity;
-    QList<QPair<QString, bool>> queue;
+    int callsInFlight;
+    QHash<QString, Session> sessions;
 
     KSMServer *const q;
 };
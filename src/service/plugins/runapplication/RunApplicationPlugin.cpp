@@ -28,6 +28,9 @@
 
 #include <KService>
 
+#include <ActivitiesSnapshot.h>
+#include <SwitchTrace.h>
+
 namespace {
     enum ActivityState {
         Running = 2,
@@ -61,10 +64,7 @@ bool RunApplicationPlugin::init(QHash<QString, QObject *> &modules)
     connect(m_activitiesService, SIGNAL(ActivityStateChanged(QString, int)),
             this, SLOT(activityStateChanged(QString, int)));
 
-    const auto currentActivity = Plugin::retrieve<QString>(
-            m_activitiesService, "CurrentActivity", "QString");
-
-    currentActivityChanged(currentActivity);
+    currentActivityChanged(ActivitiesSnapshot::current()->currentActivity);
 
     return true;
 }
@@ -81,6 +81,8 @@ void RunApplicationPlugin::currentActivityChanged(const QString &activity)
         return;
     }
 
+    SwitchTrace::Handler trace(activity, QStringLiteral("runapplication"));
+
     if (!m_currentActivity.isEmpty()) {
         executeIn(activityDirectory(activity) + "deactivated");
     }
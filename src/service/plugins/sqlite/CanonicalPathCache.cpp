@@ -0,0 +1,259 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "CanonicalPathCache.h"
+
+// Qt
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QHash>
+
+// KDE
+#include <KDirWatch>
+
+// STL
+#include <atomic>
+#include <list>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+
+namespace {
+    // How long a cached canonical path is trusted before
+    // the cache checks that it still exists, in ms
+    const qint64 recheckInterval = 10 * 1000;
+}
+
+class CanonicalPathCache::Private {
+public:
+    Private()
+        : capacity(4096)
+        , directoryCapacity(256)
+        , hits(0)
+        , misses(0)
+        , invalidations(0)
+    {
+        clock.start();
+    }
+
+    struct Entry {
+        QString canonicalPath; // empty if the file does not exist
+        QString directory;
+        qint64 checked; // ms on the clock
+        std::list<QString>::iterator position;
+    };
+
+    void watch(const QString &directory)
+    {
+        if (watchedDirectories[directory]++ == 0) {
+            watcher.addDir(directory);
+        }
+    }
+
+    void unwatch(const QString &directory)
+    {
+        auto watched = watchedDirectories.find(directory);
+
+        if (watched == watchedDirectories.end()) {
+            return;
+        }
+
+        if (--*watched == 0) {
+            watchedDirectories.erase(watched);
+            watcher.removeDir(directory);
+        }
+    }
+
+    void remove(QHash<QString, Entry>::iterator entry)
+    {
+        unwatch(entry->directory);
+        pathsInDirectory.remove(entry->directory, entry.key());
+        order.erase(entry->position);
+        entries.erase(entry);
+    }
+
+    bool remove(const QString &path)
+    {
+        const auto entry = entries.find(path);
+
+        if (entry == entries.end()) {
+            return false;
+        }
+
+        remove(entry);
+        return true;
+    }
+
+    // Removes the entries that might have been affected
+    // by a change of the specified path
+    void invalidate(const QString &path)
+    {
+        const auto parent = QFileInfo(path).absolutePath();
+
+        for (const auto &directory: { path, parent }) {
+            for (const auto &entry: pathsInDirectory.values(directory)) {
+                invalidations += remove(entry);
+            }
+        }
+
+        invalidations += remove(path);
+    }
+
+    // Evicts the least recently used entries until both the entries
+    // and the watched directories fit into their limits
+    void trim()
+    {
+        while ((entries.size() > capacity
+                    || watchedDirectories.size() > directoryCapacity)
+               && !order.empty()) {
+            remove(entries.find(order.back()));
+        }
+    }
+
+    int capacity;
+
+    // Every watched directory takes an inotify watch,
+    // which are shared with the rest of the session
+    int directoryCapacity;
+
+    QHash<QString, Entry> entries;
+    QMultiHash<QString, QString> pathsInDirectory;
+
+    // Most recently used paths are at the front
+    std::list<QString> order;
+
+    KDirWatch watcher;
+    QHash<QString, int> watchedDirectories;
+
+    QElapsedTimer clock;
+
+    std::atomic<quint64> hits;
+    std::atomic<quint64> misses;
+    std::atomic<quint64> invalidations;
+};
+
+CanonicalPathCache::CanonicalPathCache(QObject *parent)
+    : QObject(parent)
+    , d()
+{
+    const auto invalidate = [this] (const QString &path) {
+        d->invalidate(path);
+    };
+
+    connect(&d->watcher, &KDirWatch::dirty, this, invalidate);
+    connect(&d->watcher, &KDirWatch::created, this, invalidate);
+    connect(&d->watcher, &KDirWatch::deleted, this, invalidate);
+}
+
+CanonicalPathCache::~CanonicalPathCache()
+{
+}
+
+QString CanonicalPathCache::canonicalPath(const QString &path)
+{
+    auto entry = d->entries.find(path);
+    const auto now = d->clock.elapsed();
+
+    // A directory or a link further up the path might have been
+    // renamed, which the watched parent directory does not report
+    if (entry != d->entries.end() && !entry->canonicalPath.isEmpty()
+            && now - entry->checked > recheckInterval) {
+        if (QFileInfo::exists(entry->canonicalPath)) {
+            entry->checked = now;
+
+        } else {
+            d->remove(entry);
+            ++d->invalidations;
+            entry = d->entries.end();
+        }
+    }
+
+    if (entry != d->entries.end()) {
+        ++d->hits;
+
+        // Marking the entry as the most recently used one
+        d->order.splice(d->order.begin(), d->order, entry->position);
+
+        return entry->canonicalPath;
+    }
+
+    ++d->misses;
+
+    const QFileInfo file(path);
+    const auto canonicalPath = file.canonicalFilePath();
+
+    if (d->capacity <= 0) {
+        return canonicalPath;
+    }
+
+    const auto directory = file.absolutePath();
+
+    d->order.push_front(path);
+    d->entries.insert(path, Private::Entry { canonicalPath, directory, now, d->order.begin() });
+    d->pathsInDirectory.insert(directory, path);
+    d->watch(directory);
+
+    d->trim();
+
+    return canonicalPath;
+}
+
+void CanonicalPathCache::setCapacity(int capacity)
+{
+    d->capacity = capacity;
+    d->trim();
+}
+
+void CanonicalPathCache::setDirectoryCapacity(int capacity)
+{
+    d->directoryCapacity = capacity;
+    d->trim();
+}
+
+void CanonicalPathCache::clear()
+{
+    d->entries.clear();
+    d->pathsInDirectory.clear();
+    d->order.clear();
+
+    for (auto it = d->watchedDirectories.cbegin();
+         it != d->watchedDirectories.cend(); ++it) {
+        d->watcher.removeDir(it.key());
+    }
+
+    d->watchedDirectories.clear();
+}
+
+quint64 CanonicalPathCache::hits() const
+{
+    return d->hits;
+}
+
+quint64 CanonicalPathCache::misses() const
+{
+    return d->misses;
+}
+
+quint64 CanonicalPathCache::invalidations() const
+{
+    return d->invalidations;
+}
+
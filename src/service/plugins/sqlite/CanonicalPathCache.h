@@ -0,0 +1,73 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_CANONICAL_PATH_CACHE_H
+#define PLUGINS_SQLITE_CANONICAL_PATH_CACHE_H
+
+// Qt
+#include <QObject>
+#include <QString>
+
+// Utils
+#include <utils/d_ptr.h>
+
+/**
+ * Caches the canonical paths of local files, so that validating
+ * an event does not need to stat every component of its path.
+ *
+ * The cache is a bounded LRU keyed by the path as it was received.
+ * Missing files are cached as well. The entries are invalidated when
+ * the parent directory of the path changes. The number of watched
+ * directories is limited separately from the number of entries.
+ *
+ * Renames of the directories or symbolic links further up the path
+ * are not watched. Instead, when an existing file is looked up and
+ * its entry was last checked more than a few seconds ago, the cache
+ * checks that the canonical path still exists, and resolves the path
+ * again if it does not.
+ *
+ * Not thread-safe, it is meant to be used from the plugin thread.
+ * Only the counters can be read from other threads.
+ */
+class CanonicalPathCache : public QObject {
+    Q_OBJECT
+
+public:
+    explicit CanonicalPathCache(QObject *parent = nullptr);
+    ~CanonicalPathCache() override;
+
+    /**
+     * @returns the canonical path of the file, or an empty
+     *     string if the file does not exist
+     */
+    QString canonicalPath(const QString &path);
+
+    void setCapacity(int capacity);
+    void setDirectoryCapacity(int capacity);
+    void clear();
+
+    quint64 hits() const;
+    quint64 misses() const;
+    quint64 invalidations() const;
+
+private:
+    D_PTR;
+};
+
+#endif // PLUGINS_SQLITE_CANONICAL_PATH_CACHE_H
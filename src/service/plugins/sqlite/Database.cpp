@@ -43,6 +43,7 @@
 // Local
 #include "DebugResources.h"
 #include "Utils.h"
+#include <StartupProfiler.h>
 
 #include <common/database/Database.h>
 #include <common/database/schema/ResourcesDatabaseSchema.h>
@@ -72,11 +73,16 @@ ResourcesDatabaseMigrator::ResourcesDatabaseMigrator()
         qCWarning(KAMD_LOG_RESOURCES) << "Database folder can not be created!";
     }
 
-    d->database = Common::Database::instance(
-            Common::Database::ResourcesDatabase,
-            Common::Database::ReadWrite);
+    {
+        StartupProfiler::Phase phase(QStringLiteral("sqlite/database-open"));
+
+        d->database = Common::Database::instance(
+                Common::Database::ResourcesDatabase,
+                Common::Database::ReadWrite);
+    }
 
     if (d->database) {
+        StartupProfiler::Phase phase(QStringLiteral("sqlite/schema-migration"));
         Common::ResourcesDatabaseSchema::initSchema(*d->database);
     }
 }
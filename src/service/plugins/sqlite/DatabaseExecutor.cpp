@@ -0,0 +1,300 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "DatabaseExecutor.h"
+
+// Qt
+#include <QDBusConnection>
+#include <QDBusContext>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QThread>
+#include <QWaitCondition>
+
+// STL
+#include <atomic>
+#include <deque>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// Local
+#include "Database.h"
+#include "DebugResources.h"
+#include <common/database/DatabasePool.h>
+
+
+namespace {
+    // How long the writer waits for the database to be unlocked
+    // by other processes before a statement fails, in ms
+    const int writerBusyTimeout = 5000;
+}
+
+class DatabaseExecutor::Private {
+public:
+    Private(DatabaseExecutor *parent, int readerCount)
+        : lastId(0)
+        , writer(parent, *this)
+        , readers(readerCount)
+    {
+        writer.start();
+    }
+
+    ~Private()
+    {
+        // The queued writes are finished before the writer quits,
+        // so that nothing that the service has accepted is lost
+        {
+            QMutexLocker lock(&writesMutex);
+            quit = true;
+            writesCondition.wakeAll();
+        }
+
+        writer.wait();
+    }
+
+    void record(const QString &method, quint64 queueTime, quint64 runTime)
+    {
+        QMutexLocker lock(&statisticsMutex);
+
+        auto &methodStatistics = statistics[method];
+        ++methodStatistics.calls;
+        methodStatistics.queueTime += queueTime;
+        methodStatistics.runTime += runTime;
+        methodStatistics.maxLatency =
+            qMax(methodStatistics.maxLatency, queueTime + runTime);
+    }
+
+    mutable QMutex statisticsMutex;
+    QHash<QString, Statistics> statistics;
+
+    struct WriteTask {
+        quint64 id;
+        QString method;
+        Job job;
+        QElapsedTimer queued;
+    };
+
+    // These are accessed only from the executor thread
+    quint64 lastId;
+    QHash<quint64, Continuation> continuations;
+
+    // The write queue, shared with the writer thread
+    QMutex writesMutex;
+    QWaitCondition writesCondition;
+    std::deque<WriteTask> writes[Common::DatabasePool::PriorityCount];
+    std::atomic<quint64> pendingWrites { 0 };
+    bool opened = false;
+    bool openSucceeded = false;
+    bool quit = false;
+
+    // Owns the read-write connection. The writes are executed one
+    // by one, by the priority, and in the order in which they were
+    // queued for the same priority
+    class Writer : public QThread {
+    public:
+        Writer(DatabaseExecutor *executor, Private &d)
+            : executor(executor)
+            , d(d)
+        {
+        }
+
+        void run() override
+        {
+            // The connection is opened, and the schema migrated, in
+            // this thread - the connection can not be shared with
+            // the other threads
+            auto database = resourcesDatabase();
+
+            if (database) {
+                database->setPragma(QStringLiteral("busy_timeout = %1")
+                                        .arg(writerBusyTimeout));
+            }
+
+            {
+                QMutexLocker lock(&d.writesMutex);
+                d.opened = true;
+                d.openSucceeded = (bool)database;
+                d.writesCondition.wakeAll();
+            }
+
+            forever {
+                WriteTask task;
+
+                {
+                    QMutexLocker lock(&d.writesMutex);
+
+                    while (!d.quit && d.pendingWrites == 0) {
+                        d.writesCondition.wait(&d.writesMutex);
+                    }
+
+                    if (d.pendingWrites == 0) break;
+
+                    for (auto &queue: d.writes) {
+                        if (queue.empty()) continue;
+
+                        task = std::move(queue.front());
+                        queue.pop_front();
+                        break;
+                    }
+
+                    --d.pendingWrites;
+                }
+
+                const quint64 queueTime = task.queued.nsecsElapsed() / 1000;
+
+                QElapsedTimer timer;
+                timer.start();
+
+                const auto result = database ? task.job(*database) : QVariant();
+
+                d.record(task.method, queueTime, timer.nsecsElapsed() / 1000);
+
+                emit executor->finished(task.id, result);
+            }
+        }
+
+    private:
+        DatabaseExecutor *const executor;
+        Private &d;
+    } writer;
+
+    // The pool is destroyed first, the running jobs use the members above
+    Common::DatabasePool readers;
+};
+
+DatabaseExecutor::DelayedReply::DelayedReply(const QDBusContext *context)
+{
+    if (!context->calledFromDBus()) return;
+
+    context->setDelayedReply(true);
+
+    m_connection = context->connection().name();
+    m_message = context->message();
+}
+
+void DatabaseExecutor::DelayedReply::send(const QVariant &result) const
+{
+    if (m_message.type() != QDBusMessage::MethodCallMessage) return;
+
+    auto reply = m_message.createReply();
+
+    if (result.isValid()) {
+        reply << result;
+    }
+
+    QDBusConnection(m_connection).send(reply);
+}
+
+DatabaseExecutor::DatabaseExecutor(int readers, QObject *parent)
+    : QObject(parent)
+    , d(this, readers)
+{
+    connect(this, &DatabaseExecutor::finished,
+            this, &DatabaseExecutor::continueWith,
+            Qt::QueuedConnection);
+}
+
+DatabaseExecutor::~DatabaseExecutor()
+{
+}
+
+bool DatabaseExecutor::waitForDatabase()
+{
+    QMutexLocker lock(&d->writesMutex);
+
+    while (!d->opened) {
+        d->writesCondition.wait(&d->writesMutex);
+    }
+
+    return d->openSucceeded;
+}
+
+void DatabaseExecutor::execute(const QString &method, Access access,
+                               Priority priority, const Job &job,
+                               const Continuation &continuation)
+{
+    const auto id = ++d->lastId;
+
+    if (continuation) {
+        d->continuations[id] = continuation;
+    }
+
+    QElapsedTimer queued;
+    queued.start();
+
+    if (access == Write) {
+        QMutexLocker lock(&d->writesMutex);
+
+        d->writes[qBound(0, (int)priority, Common::DatabasePool::PriorityCount - 1)]
+            .push_back(Private::WriteTask { id, method, job, queued });
+        ++d->pendingWrites;
+
+        d->writesCondition.wakeAll();
+
+        return;
+    }
+
+    d->readers.execute(priority, [=] (Common::Database *database) {
+        const quint64 queueTime = queued.nsecsElapsed() / 1000;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        const auto result = database ? job(*database) : QVariant();
+
+        d->record(method, queueTime, timer.nsecsElapsed() / 1000);
+
+        emit finished(id, result);
+    });
+}
+
+void DatabaseExecutor::continueWith(quint64 id, const QVariant &result)
+{
+    const auto continuation = d->continuations.take(id);
+
+    if (continuation) {
+        continuation(result);
+    }
+}
+
+QStringList DatabaseExecutor::methods() const
+{
+    QMutexLocker lock(&d->statisticsMutex);
+    return d->statistics.keys();
+}
+
+DatabaseExecutor::Statistics DatabaseExecutor::statistics(const QString &method) const
+{
+    QMutexLocker lock(&d->statisticsMutex);
+    return d->statistics.value(method, Statistics { 0, 0, 0, 0 });
+}
+
+quint64 DatabaseExecutor::pendingWrites() const
+{
+    return d->pendingWrites;
+}
+
+const Common::DatabasePool &DatabaseExecutor::readerPool() const
+{
+    return d->readers;
+}
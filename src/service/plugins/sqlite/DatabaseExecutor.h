@@ -0,0 +1,143 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_DATABASE_EXECUTOR_H
+#define PLUGINS_SQLITE_DATABASE_EXECUTOR_H
+
+// Qt
+#include <QDBusMessage>
+#include <QObject>
+#include <QStringList>
+#include <QVariant>
+
+// STL
+#include <functional>
+
+// Utils
+#include <utils/d_ptr.h>
+
+// Local
+#include <common/database/Database.h>
+
+class QDBusContext;
+
+namespace Common {
+    class DatabasePool;
+} // namespace Common
+
+/**
+ * Runs the database work of the plugin outside of the plugin thread,
+ * and sends the replies to the D-Bus calls when the jobs are finished.
+ *
+ * The reads are spread over a pool of read-only connections, each of
+ * them living in its own thread, so a slow query blocks neither the
+ * other callers nor the processing of the events.
+ *
+ * All the writes, including the storing of the events, go through a
+ * single writer thread which owns the read-write connection, so that
+ * there is only one writer to the database. The jobs with the higher
+ * priority are executed first, and the jobs with the same priority
+ * in the order in which they were queued.
+ */
+class DatabaseExecutor : public QObject {
+    Q_OBJECT
+
+public:
+    enum Access {
+        Read,
+        Write
+    };
+
+    enum Priority {
+        Interactive = 0,
+        Normal      = 1,
+        Background  = 2
+    };
+
+    typedef std::function<QVariant (Common::Database &database)> Job;
+    typedef std::function<void (const QVariant &result)> Continuation;
+
+    /**
+     * The reply to a D-Bus call, to be sent after the job finishes
+     */
+    class DelayedReply {
+    public:
+        /**
+         * Marks the current call as delayed, if the method
+         * was called through D-Bus
+         */
+        explicit DelayedReply(const QDBusContext *context);
+
+        void send(const QVariant &result = QVariant()) const;
+
+    private:
+        QString m_connection;
+        QDBusMessage m_message;
+    };
+
+    struct Statistics {
+        quint64 calls;
+        quint64 queueTime;  // us, total
+        quint64 runTime;    // us, total
+        quint64 maxLatency; // us
+    };
+
+    explicit DatabaseExecutor(int readers, QObject *parent = nullptr);
+
+    /**
+     * Waits for the queued writes to finish
+     */
+    ~DatabaseExecutor() override;
+
+    /**
+     * Blocks until the writer thread has opened the database
+     * @returns whether the database could be opened
+     */
+    bool waitForDatabase();
+
+    /**
+     * Queues the job for one of the database threads
+     * @param method the name under which the latency is recorded
+     * @param continuation called in the thread of the executor
+     *     with the result of the job
+     * This needs to be called from the thread of the executor
+     */
+    void execute(const QString &method, Access access, Priority priority,
+                 const Job &job,
+                 const Continuation &continuation = Continuation());
+
+    // These can be read from any thread
+    QStringList methods() const;
+    Statistics statistics(const QString &method) const;
+    quint64 pendingWrites() const;
+
+    const Common::DatabasePool &readerPool() const;
+
+Q_SIGNALS:
+    // Emitted by the database threads
+    void finished(quint64 id, const QVariant &result);
+
+private Q_SLOTS:
+    void continueWith(quint64 id, const QVariant &result);
+
+private:
+    D_PTR;
+};
+
+#endif // PLUGINS_SQLITE_DATABASE_EXECUTOR_H
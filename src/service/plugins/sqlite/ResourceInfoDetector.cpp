@@ -0,0 +1,248 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "ResourceInfoDetector.h"
+
+// Qt
+#include <QDateTime>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QSet>
+#include <QThreadPool>
+#include <QTimer>
+#include <QUrl>
+
+// KDE
+#include <kfileitem.h>
+
+// STL
+#include <atomic>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+
+namespace {
+    const int maxCachedFiles = 10000;
+
+    struct CachedInfo {
+        qint64 modified;
+        QString mimetype;
+        QString title;
+    };
+
+    // Looked up by the workers, updated from the detector thread
+    struct Cache {
+        QMutex mutex;
+        QHash<QString, CachedInfo> entries;
+    };
+}
+
+class ResourceInfoDetector::Private {
+public:
+    Private()
+        : pendingCount(0)
+        , detectedCount(0)
+        , cacheHitCount(0)
+    {
+    }
+
+    Cache cache;
+
+    // These are accessed only from the detector thread
+    QSet<QString> pendingFiles;
+    QList<Info> batch;
+    QTimer flushTimer;
+
+    QThreadPool pool;
+
+    std::atomic<quint64> pendingCount;
+    std::atomic<quint64> detectedCount;
+    std::atomic<quint64> cacheHitCount;
+};
+
+namespace {
+    class DetectionJob : public QRunnable {
+    public:
+        DetectionJob(ResourceInfoDetector *detector, Cache &cache,
+                     const QString &uri, const QString &file)
+            : detector(detector)
+            , cache(cache)
+            , uri(uri)
+            , file(file)
+        {
+        }
+
+        void run() override
+        {
+            const QFileInfo info(file);
+
+            if (!info.exists()) {
+                report(QString(), QString(), -1, false);
+                return;
+            }
+
+            const auto modified = info.lastModified().toMSecsSinceEpoch();
+
+            {
+                QMutexLocker locker(&cache.mutex);
+                const auto cached = cache.entries.constFind(file);
+
+                if (cached != cache.entries.cend() && cached->modified == modified) {
+                    const auto mimetype = cached->mimetype;
+                    const auto title = cached->title;
+                    locker.unlock();
+
+                    report(mimetype, title, modified, true);
+                    return;
+                }
+            }
+
+            // This might need to read the contents of the file
+            // to determine its type
+            KFileItem item(QUrl::fromLocalFile(file));
+
+            const auto text = item.text();
+            report(item.mimetype(), text.isEmpty() ? uri : text, modified,
+                   false);
+        }
+
+    private:
+        void report(const QString &mimetype, const QString &title,
+                    qint64 modified, bool fromCache)
+        {
+            QMetaObject::invokeMethod(detector, "addResult",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QString, file),
+                                      Q_ARG(QString, mimetype),
+                                      Q_ARG(QString, title),
+                                      Q_ARG(qint64, modified),
+                                      Q_ARG(bool, fromCache));
+        }
+
+        ResourceInfoDetector *const detector;
+        Cache &cache;
+        const QString uri;
+        const QString file;
+    };
+}
+
+ResourceInfoDetector::ResourceInfoDetector(QObject *parent)
+    : QObject(parent)
+    , d()
+{
+    d->pool.setMaxThreadCount(2);
+
+    // Collecting the results for a while, so that
+    // they can be written in one transaction
+    d->flushTimer.setInterval(500);
+    d->flushTimer.setSingleShot(true);
+    connect(&d->flushTimer, &QTimer::timeout,
+            this, &ResourceInfoDetector::flush);
+}
+
+ResourceInfoDetector::~ResourceInfoDetector()
+{
+    d->pool.clear();
+    d->pool.waitForDone();
+}
+
+void ResourceInfoDetector::setThreadCount(int count)
+{
+    d->pool.setMaxThreadCount(qMax(1, count));
+}
+
+void ResourceInfoDetector::detect(const QString &uri)
+{
+    const QUrl url = QUrl::fromUserInput(uri);
+
+    if (!url.isLocalFile()) return;
+
+    const QString file = url.toLocalFile();
+
+    if (d->pendingFiles.contains(file)) return;
+
+    d->pendingFiles << file;
+    ++d->pendingCount;
+
+    d->pool.start(new DetectionJob(this, d->cache, uri, file));
+}
+
+void ResourceInfoDetector::addResult(const QString &file,
+                                     const QString &mimetype,
+                                     const QString &title,
+                                     qint64 modified, bool fromCache)
+{
+    d->pendingFiles.remove(file);
+    --d->pendingCount;
+
+    // The file does not exist
+    if (modified < 0) return;
+
+    if (fromCache) {
+        ++d->cacheHitCount;
+
+    } else {
+        QMutexLocker locker(&d->cache.mutex);
+
+        if (d->cache.entries.size() >= maxCachedFiles) {
+            d->cache.entries.clear();
+        }
+
+        d->cache.entries[file] = CachedInfo { modified, mimetype, title };
+    }
+
+    ++d->detectedCount;
+
+    d->batch << Info { file, mimetype, title };
+
+    if (!d->flushTimer.isActive()) {
+        d->flushTimer.start();
+    }
+}
+
+void ResourceInfoDetector::flush()
+{
+    if (d->batch.isEmpty()) return;
+
+    QList<Info> batch;
+    std::swap(batch, d->batch);
+
+    emit detected(batch);
+}
+
+quint64 ResourceInfoDetector::pending() const
+{
+    return d->pendingCount;
+}
+
+quint64 ResourceInfoDetector::detectedCount() const
+{
+    return d->detectedCount;
+}
+
+quint64 ResourceInfoDetector::cacheHits() const
+{
+    return d->cacheHitCount;
+}
+
@@ -0,0 +1,77 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_RESOURCE_INFO_DETECTOR_H
+#define PLUGINS_SQLITE_RESOURCE_INFO_DETECTOR_H
+
+// Qt
+#include <QObject>
+#include <QString>
+
+// Utils
+#include <utils/d_ptr.h>
+
+/**
+ * Detects the mimetype and the title of the local files in
+ * a pool of worker threads.
+ *
+ * The requests are deduplicated while they are pending, and
+ * the results are cached by the path and the modification time
+ * of the file. The results are delivered in batches through
+ * the detected signal, in the thread of the detector.
+ */
+class ResourceInfoDetector : public QObject {
+    Q_OBJECT
+
+public:
+    struct Info {
+        QString file;
+        QString mimetype;
+        QString title;
+    };
+
+    explicit ResourceInfoDetector(QObject *parent = nullptr);
+    ~ResourceInfoDetector() override;
+
+    /**
+     * Schedules the detection, does not block.
+     * @param uri the resource as it was registered
+     */
+    void detect(const QString &uri);
+
+    void setThreadCount(int count);
+
+    // Counters, these can be read from other threads
+    quint64 pending() const;
+    quint64 detectedCount() const;
+    quint64 cacheHits() const;
+
+Q_SIGNALS:
+    void detected(const QList<ResourceInfoDetector::Info> &batch);
+
+private Q_SLOTS:
+    void addResult(const QString &file, const QString &mimetype,
+                   const QString &title, qint64 modified, bool fromCache);
+    void flush();
+
+private:
+    D_PTR;
+};
+
+#endif // PLUGINS_SQLITE_RESOURCE_INFO_DETECTOR_H
@@ -0,0 +1,417 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "ResourceInfoWriter.h"
+
+// Qt
+#include <QHash>
+#include <QSqlQuery>
+#include <QStringList>
+#include <QTimer>
+
+// STL
+#include <atomic>
+#include <memory>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// Local
+#include "Database.h"
+#include "DatabaseExecutor.h"
+#include "ResourcePathIndex.h"
+#include "StatsPlugin.h"
+#include "Utils.h"
+
+
+namespace {
+    enum Column {
+        TitleColumn    = 1,
+        MimetypeColumn = 2
+    };
+
+    // The pending value of one of the columns
+    struct Field {
+        Field()
+            : value(QStringLiteral(""))
+            , isSet(false)
+            , automatic(true)
+        {
+        }
+
+        void set(const QString &newValue, bool newAutomatic)
+        {
+            // A detected value does not replace a registered one
+            if (isSet && !automatic && newAutomatic) return;
+
+            value = newValue;
+            isSet = true;
+            automatic = newAutomatic;
+        }
+
+        QString value;
+        bool isSet : 1;
+        bool automatic : 1;
+    };
+
+    struct PendingInfo {
+        Field title;
+        Field mimetype;
+    };
+
+    QString upsertQuery(int columns)
+    {
+        QStringList assignments;
+        QStringList conditions;
+
+        const auto addColumn = [&] (const QString &value, const QString &flag) {
+            // A detected value is applied only over a detected one.
+            // The expressions on the right see the row as it was
+            // before the update.
+            const auto applies =
+                QStringLiteral("(%1 OR NOT excluded.%1)").arg(flag);
+
+            assignments
+                << QStringLiteral("%1 = CASE WHEN %2 THEN excluded.%1 ELSE %1 END")
+                       .arg(value, applies)
+                << QStringLiteral("%1 = %1 AND excluded.%1").arg(flag);
+
+            // Not touching the row if nothing would change
+            conditions
+                << QStringLiteral("(%1 AND (%2 IS NOT excluded.%2 OR %3 IS NOT excluded.%3))")
+                       .arg(applies, value, flag);
+        };
+
+        if (columns & TitleColumn) {
+            addColumn(QStringLiteral("title"), QStringLiteral("autoTitle"));
+        }
+
+        if (columns & MimetypeColumn) {
+            addColumn(QStringLiteral("mimetype"), QStringLiteral("autoMimetype"));
+        }
+
+        // The columns that are not being set get the same
+        // defaults as before - empty and detected
+        return QStringLiteral(
+            "INSERT INTO ResourceInfo ("
+                "  targettedResource"
+                ", title"
+                ", autoTitle"
+                ", mimetype"
+                ", autoMimetype"
+                ", targettedPath"
+            ") VALUES ("
+                "  :targettedResource"
+                ", :title"
+                ", :autoTitle"
+                ", :mimetype"
+                ", :autoMimetype"
+                ", :targettedPath"
+            ") "
+            "ON CONFLICT(targettedResource) DO UPDATE SET "
+            ) + assignments.join(QStringLiteral(", "))
+              + QStringLiteral(" WHERE ")
+              + conditions.join(QStringLiteral(" OR "));
+    }
+
+    // ON CONFLICT ... DO UPDATE is supported since SQLite 3.24
+    bool supportsUpsert(const Common::Database &database)
+    {
+        auto query = database.execQuery(QStringLiteral("SELECT sqlite_version()"), true);
+
+        if (!query.next()) {
+            return false;
+        }
+
+        const auto version = query.value(0).toString().split(QLatin1Char('.'));
+
+        return version.size() >= 2
+               && (version[0].toInt() > 3
+                   || (version[0].toInt() == 3 && version[1].toInt() >= 24));
+    }
+
+    // Applies the pending value over the one in the database,
+    // following the same rules as the upsert
+    bool merge(const Field &field, QString &value, bool &automatic)
+    {
+        if (!field.isSet) return false;
+
+        const auto newValue = (automatic || !field.automatic) ? field.value : value;
+        const bool newAutomatic = automatic && field.automatic;
+
+        if (newValue == value && newAutomatic == automatic) return false;
+
+        value = newValue;
+        automatic = newAutomatic;
+        return true;
+    }
+}
+
+class ResourceInfoWriter::Private {
+public:
+    Private()
+        : upsertChecked(false)
+        , upsertSupported(false)
+        , replacedStatements(0)
+        , updateCount(0)
+        , statementCount(0)
+        , savedCount(0)
+        , lastSavedCount(0)
+    {
+    }
+
+    void schedule()
+    {
+        ++updateCount;
+
+        if (!flushTimer.isActive()) {
+            flushTimer.start();
+        }
+    }
+
+    // Writes the info without the upsert, for the older SQLite versions
+    void write(Common::Database &database, const QString &resource,
+               const PendingInfo &info, const QVariant &path)
+    {
+        Utils::prepare(database, selectQuery, QStringLiteral(
+            "SELECT title, autoTitle, mimetype, autoMimetype "
+            "FROM ResourceInfo WHERE targettedResource = :targettedResource"
+        ));
+
+        Utils::exec(Utils::FailOnError, *selectQuery,
+            ":targettedResource", resource
+        );
+
+        if (!selectQuery->next()) {
+            Utils::prepare(database, insertQuery, QStringLiteral(
+                "INSERT INTO ResourceInfo ("
+                    "  targettedResource, title, autoTitle"
+                    ", mimetype, autoMimetype, targettedPath"
+                ") VALUES ("
+                    "  :targettedResource, :title, :autoTitle"
+                    ", :mimetype, :autoMimetype, :targettedPath"
+                ")"
+            ));
+
+            Utils::exec(Utils::FailOnError, *insertQuery,
+                ":targettedResource" , resource                          ,
+                ":title"             , info.title.value                  ,
+                ":autoTitle"         , (info.title.automatic ? 1 : 0)    ,
+                ":mimetype"          , info.mimetype.value               ,
+                ":autoMimetype"      , (info.mimetype.automatic ? 1 : 0) ,
+                ":targettedPath"     , path
+            );
+
+            return;
+        }
+
+        auto title = selectQuery->value(0).toString();
+        bool autoTitle = selectQuery->value(1).toBool();
+        auto mimetype = selectQuery->value(2).toString();
+        bool autoMimetype = selectQuery->value(3).toBool();
+        selectQuery->finish();
+
+        const bool titleChanged = merge(info.title, title, autoTitle);
+        const bool mimetypeChanged = merge(info.mimetype, mimetype, autoMimetype);
+
+        if (!titleChanged && !mimetypeChanged) return;
+
+        Utils::prepare(database, updateQuery, QStringLiteral(
+            "UPDATE ResourceInfo SET "
+                "  title = :title, autoTitle = :autoTitle"
+                ", mimetype = :mimetype, autoMimetype = :autoMimetype "
+            "WHERE targettedResource = :targettedResource"
+        ));
+
+        Utils::exec(Utils::FailOnError, *updateQuery,
+            ":targettedResource" , resource               ,
+            ":title"             , title                  ,
+            ":autoTitle"         , (autoTitle ? 1 : 0)    ,
+            ":mimetype"          , mimetype               ,
+            ":autoMimetype"      , (autoMimetype ? 1 : 0)
+        );
+    }
+
+    QHash<QString, PendingInfo> pending;
+
+    bool upsertChecked;
+    bool upsertSupported;
+
+    // How many statements the separate updates of the current
+    // batch would have needed. This is a lower bound - it does
+    // not count the inserts of the new resources
+    quint64 replacedStatements;
+
+    QTimer flushTimer;
+
+    // One query for each combination of the columns
+    std::unique_ptr<QSqlQuery> upsertQueries[3];
+
+    std::unique_ptr<QSqlQuery> selectQuery;
+    std::unique_ptr<QSqlQuery> insertQuery;
+    std::unique_ptr<QSqlQuery> updateQuery;
+
+    std::atomic<quint64> updateCount;
+    std::atomic<quint64> statementCount;
+    std::atomic<quint64> savedCount;
+    std::atomic<quint64> lastSavedCount;
+};
+
+ResourceInfoWriter::ResourceInfoWriter(QObject *parent)
+    : QObject(parent)
+    , d()
+{
+    d->flushTimer.setInterval(500);
+    d->flushTimer.setSingleShot(true);
+    connect(&d->flushTimer, &QTimer::timeout,
+            this, &ResourceInfoWriter::flush);
+}
+
+ResourceInfoWriter::~ResourceInfoWriter()
+{
+    flush();
+}
+
+void ResourceInfoWriter::setTitle(const QString &uri, const QString &title)
+{
+    d->pending[uri].title.set(title, false);
+
+    // Checking whether the resource exists, and updating it
+    d->replacedStatements += 2;
+    d->schedule();
+}
+
+void ResourceInfoWriter::setMimetype(const QString &uri,
+                                     const QString &mimetype)
+{
+    d->pending[uri].mimetype.set(mimetype, false);
+
+    d->replacedStatements += 2;
+    d->schedule();
+}
+
+void ResourceInfoWriter::setDetectedInfo(const QString &uri,
+                                         const QString &title,
+                                         const QString &mimetype)
+{
+    auto &info = d->pending[uri];
+    info.title.set(title, true);
+    info.mimetype.set(mimetype, true);
+
+    // Only the check, if the resource was already known
+    d->replacedStatements += 1;
+    d->schedule();
+}
+
+void ResourceInfoWriter::flush()
+{
+    d->flushTimer.stop();
+
+    if (d->pending.isEmpty()) return;
+
+    QHash<QString, PendingInfo> pending;
+    std::swap(pending, d->pending);
+
+    const quint64 replacedStatements = d->replacedStatements;
+    d->replacedStatements = 0;
+
+    // The batch is written by the writer thread, the queries
+    // and the upsert check are used only from there
+    const auto job = [this, pending, replacedStatements] (Common::Database &database) {
+        if (!d->upsertChecked) {
+            d->upsertChecked = true;
+            d->upsertSupported = supportsUpsert(database);
+
+            if (!d->upsertSupported) {
+                qCDebug(KAMD_LOG_RESOURCES) << "SQLite does not support upserts,"
+                                               " writing the resource info separately";
+            }
+        }
+
+        {
+            DATABASE_TRANSACTION(database);
+
+            const auto paths = StatsPlugin::self()->resourcePathIndex();
+
+            for (auto it = pending.cbegin(); it != pending.cend(); ++it) {
+                const auto &info = it.value();
+
+                if (!d->upsertSupported) {
+                    d->write(database, it.key(), info, paths->pathId(it.key()));
+                    continue;
+                }
+
+                const int columns = (info.title.isSet    ? TitleColumn    : 0)
+                                  | (info.mimetype.isSet ? MimetypeColumn : 0);
+
+                auto &query = d->upsertQueries[columns - 1];
+                Utils::prepare(database, query, upsertQuery(columns));
+
+                Utils::exec(Utils::FailOnError, *query,
+                    ":targettedResource" , it.key()                          ,
+                    ":title"             , info.title.value                  ,
+                    ":autoTitle"         , (info.title.automatic ? 1 : 0)    ,
+                    ":mimetype"          , info.mimetype.value               ,
+                    ":autoMimetype"      , (info.mimetype.automatic ? 1 : 0) ,
+                    ":targettedPath"     , paths->pathId(it.key())
+                );
+            }
+        }
+
+        const quint64 statements = pending.size();
+        const quint64 saved = replacedStatements > statements
+                                  ? replacedStatements - statements
+                                  : 0;
+
+        d->statementCount += statements;
+        d->savedCount += saved;
+        d->lastSavedCount = saved;
+
+        qCDebug(KAMD_LOG_RESOURCES) << "Saved the info for" << statements
+                                    << "resources," << saved
+                                    << "statements less than separate updates";
+
+        return QVariant();
+    };
+
+    StatsPlugin::self()->databaseExecutor()->execute(
+        QStringLiteral("WriteResourceInfo"),
+        DatabaseExecutor::Write, DatabaseExecutor::Background, job);
+}
+
+quint64 ResourceInfoWriter::updates() const
+{
+    return d->updateCount;
+}
+
+quint64 ResourceInfoWriter::statements() const
+{
+    return d->statementCount;
+}
+
+quint64 ResourceInfoWriter::statementsSaved() const
+{
+    return d->savedCount;
+}
+
+quint64 ResourceInfoWriter::lastBatchStatementsSaved() const
+{
+    return d->lastSavedCount;
+}
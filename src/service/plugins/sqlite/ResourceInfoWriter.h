@@ -0,0 +1,66 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_RESOURCE_INFO_WRITER_H
+#define PLUGINS_SQLITE_RESOURCE_INFO_WRITER_H
+
+// Qt
+#include <QObject>
+#include <QString>
+
+// Utils
+#include <utils/d_ptr.h>
+
+/**
+ * Collects the titles and the mimetypes of the resources for a short
+ * while, and writes them with a single upsert per resource.
+ *
+ * The values set by the agents have precedence over the automatically
+ * detected ones - a detected value never replaces a value that was set
+ * explicitly, neither in the pending batch nor in the database.
+ */
+class ResourceInfoWriter : public QObject {
+    Q_OBJECT
+
+public:
+    explicit ResourceInfoWriter(QObject *parent = nullptr);
+    ~ResourceInfoWriter() override;
+
+    // The values registered by the agents
+    void setTitle(const QString &uri, const QString &title);
+    void setMimetype(const QString &uri, const QString &mimetype);
+
+    // The values found by ResourceInfoDetector
+    void setDetectedInfo(const QString &uri, const QString &title,
+                         const QString &mimetype);
+
+    // Counters, these can be read from other threads
+    quint64 updates() const;
+    quint64 statements() const;
+    quint64 statementsSaved() const;
+    quint64 lastBatchStatementsSaved() const;
+
+public Q_SLOTS:
+    void flush();
+
+private:
+    D_PTR;
+};
+
+#endif // PLUGINS_SQLITE_RESOURCE_INFO_WRITER_H
@@ -39,7 +39,11 @@
 #include "Database.h"
 #include "Utils.h"
 #include "StatsPlugin.h"
+#include "CanonicalPathCache.h"
+#include "ResourcePathIndex.h"
+#include "DatabaseExecutor.h"
 #include "resourcelinkingadaptor.h"
+#include <SwitchTrace.h>
 
 ResourceLinking::ResourceLinking(QObject *parent)
     : QObject(parent)
@@ -87,25 +91,49 @@ void ResourceLinking::LinkResourceToActivity(QString initiatingAgent,
                "ResourceLinking::LinkResourceToActivity",
                "Resource should not be empty");
 
-    Utils::prepare(*resourcesDatabase(), linkResourceToActivityQuery,
-        QStringLiteral(
-            "INSERT OR REPLACE INTO ResourceLink"
-            "        (usedActivity,  initiatingAgent,  targettedResource) "
-            "VALUES ( "
-                "COALESCE(:usedActivity,''),"
-                "COALESCE(:initiatingAgent,''),"
-                "COALESCE(:targettedResource,'')"
-            ")"
-        ));
+    const DatabaseExecutor::DelayedReply reply(this);
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+    const auto job = [=] (Common::Database &database) {
+        Utils::prepare(database, linkResourceToActivityQuery,
+            QStringLiteral(
+                "INSERT OR REPLACE INTO ResourceLink"
+                "        (usedActivity,  initiatingAgent,  targettedResource,  targettedPath) "
+                "VALUES ( "
+                    "COALESCE(:usedActivity,''),"
+                    "COALESCE(:initiatingAgent,''),"
+                    "COALESCE(:targettedResource,''),"
+                    ":targettedPath"
+                ")"
+            ));
 
-    Utils::exec(Utils::FailOnError, *linkResourceToActivityQuery,
-        ":usedActivity"      , usedActivity,
-        ":initiatingAgent"   , initiatingAgent,
-        ":targettedResource" , targettedResource
-    );
+        DATABASE_TRANSACTION(database);
+
+        Utils::exec(Utils::FailOnError, *linkResourceToActivityQuery,
+            ":usedActivity"      , usedActivity,
+            ":initiatingAgent"   , initiatingAgent,
+            ":targettedResource" , targettedResource,
+            ":targettedPath"     , StatsPlugin::self()->resourcePathIndex()
+                                       ->pathId(targettedResource)
+        );
+
+        return QVariant();
+    };
+
+    // The link is saved by the writer thread, the notifications
+    // are sent and the call is answered when it is done
+    StatsPlugin::self()->databaseExecutor()->execute(
+        QStringLiteral("LinkResourceToActivity"),
+        DatabaseExecutor::Write, DatabaseExecutor::Interactive, job,
+        [=] (const QVariant &) {
+            linkedResource(initiatingAgent, targettedResource, usedActivity);
+            reply.send();
+        });
+}
 
+void ResourceLinking::linkedResource(const QString &initiatingAgent,
+                                     const QString &targettedResource,
+                                     const QString &usedActivity)
+{
     if (!usedActivity.isEmpty()) {
         // qCDebug(KAMD_LOG_RESOURCES) << "Sending link event added: activities:/" << usedActivity;
         org::kde::KDirNotify::emitFilesAdded(QUrl(QStringLiteral("activities:/")
@@ -144,37 +172,56 @@ void ResourceLinking::UnlinkResourceFromActivity(QString initiatingAgent,
                "ResourceLinking::UnlinkResourceFromActivity",
                "Resource should not be empty");
 
-    QSqlQuery *query = nullptr;
+    const DatabaseExecutor::DelayedReply reply(this);
+
+    const auto job = [=] (Common::Database &database) {
+        QSqlQuery *query = nullptr;
+
+        if (usedActivity == ":any") {
+            Utils::prepare(database, unlinkResourceFromAllActivitiesQuery,
+                QStringLiteral(
+                    "DELETE FROM ResourceLink "
+                    "WHERE "
+                    "initiatingAgent   = COALESCE(:initiatingAgent  , '') AND "
+                    "targettedResource = COALESCE(:targettedResource, '') "
+                ));
+            query = unlinkResourceFromAllActivitiesQuery.get();
+        } else {
+            Utils::prepare(database, unlinkResourceFromActivityQuery,
+                QStringLiteral(
+                    "DELETE FROM ResourceLink "
+                    "WHERE "
+                    "usedActivity      = COALESCE(:usedActivity     , '') AND "
+                    "initiatingAgent   = COALESCE(:initiatingAgent  , '') AND "
+                    "targettedResource = COALESCE(:targettedResource, '') "
+                ));
+            query = unlinkResourceFromActivityQuery.get();
+        }
 
-    if (usedActivity == ":any") {
-        Utils::prepare(*resourcesDatabase(), unlinkResourceFromAllActivitiesQuery,
-            QStringLiteral(
-                "DELETE FROM ResourceLink "
-                "WHERE "
-                "initiatingAgent   = COALESCE(:initiatingAgent  , '') AND "
-                "targettedResource = COALESCE(:targettedResource, '') "
-            ));
-        query = unlinkResourceFromAllActivitiesQuery.get();
-    } else {
-        Utils::prepare(*resourcesDatabase(), unlinkResourceFromActivityQuery,
-            QStringLiteral(
-                "DELETE FROM ResourceLink "
-                "WHERE "
-                "usedActivity      = COALESCE(:usedActivity     , '') AND "
-                "initiatingAgent   = COALESCE(:initiatingAgent  , '') AND "
-                "targettedResource = COALESCE(:targettedResource, '') "
-            ));
-        query = unlinkResourceFromActivityQuery.get();
-    }
+        DATABASE_TRANSACTION(database);
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+        Utils::exec(Utils::FailOnError, *query,
+            ":usedActivity"      , usedActivity,
+            ":initiatingAgent"   , initiatingAgent,
+            ":targettedResource" , targettedResource
+        );
 
-    Utils::exec(Utils::FailOnError, *query,
-        ":usedActivity"      , usedActivity,
-        ":initiatingAgent"   , initiatingAgent,
-        ":targettedResource" , targettedResource
-    );
+        return QVariant();
+    };
 
+    StatsPlugin::self()->databaseExecutor()->execute(
+        QStringLiteral("UnlinkResourceFromActivity"),
+        DatabaseExecutor::Write, DatabaseExecutor::Interactive, job,
+        [=] (const QVariant &) {
+            unlinkedResource(initiatingAgent, targettedResource, usedActivity);
+            reply.send();
+        });
+}
+
+void ResourceLinking::unlinkedResource(const QString &initiatingAgent,
+                                       const QString &targettedResource,
+                                       const QString &usedActivity)
+{
     if (!usedActivity.isEmpty()) {
         // auto mangled = QString::fromUtf8(QUrl::toPercentEncoding(targettedResource));
         auto mangled = QString::fromLatin1(targettedResource.toUtf8().toBase64(
@@ -213,8 +260,11 @@ bool ResourceLinking::IsResourceLinkedToActivity(QString initiatingAgent,
                "ResourceLinking::IsResourceLinkedToActivity",
                "Resource should not be empty");
 
-    Utils::prepare(*resourcesDatabase(), isResourceLinkedToActivityQuery,
-        QStringLiteral(
+    const auto job = [=] (Common::Database &database) {
+        // The query is not cached, the job can be executed
+        // in any of the reader threads
+        auto query = database.createQuery();
+        query.prepare(QStringLiteral(
             "SELECT * FROM ResourceLink "
             "WHERE "
             "usedActivity      = COALESCE(:usedActivity     , '') AND "
@@ -222,13 +272,34 @@ bool ResourceLinking::IsResourceLinkedToActivity(QString initiatingAgent,
             "targettedResource = COALESCE(:targettedResource, '') "
         ));
 
-    Utils::exec(Utils::FailOnError, *isResourceLinkedToActivityQuery,
-        ":usedActivity"      , usedActivity,
-        ":initiatingAgent"   , initiatingAgent,
-        ":targettedResource" , targettedResource
-    );
+        Utils::exec(Utils::FailOnError, query,
+            ":usedActivity"      , usedActivity,
+            ":initiatingAgent"   , initiatingAgent,
+            ":targettedResource" , targettedResource
+        );
+
+        return QVariant(query.next());
+    };
+
+    // The D-Bus callers get the reply when the query finishes,
+    // the plugin thread does not wait for it
+    if (calledFromDBus()) {
+        const DatabaseExecutor::DelayedReply reply(this);
+
+        StatsPlugin::self()->databaseExecutor()->execute(
+            QStringLiteral("IsResourceLinkedToActivity"),
+            DatabaseExecutor::Read, DatabaseExecutor::Interactive, job,
+            [=] (const QVariant &result) { reply.send(result); });
 
-    return isResourceLinkedToActivityQuery->next();
+        return false;
+    }
+
+    // The read-write connection belongs to the writer thread,
+    // the direct calls get a read-only one of this thread
+    const auto database = Common::Database::instance(
+        Common::Database::ResourcesDatabase, Common::Database::ReadOnly);
+
+    return database && job(*database).toBool();
 }
 
 bool ResourceLinking::validateArguments(QString &initiatingAgent,
@@ -246,14 +317,15 @@ bool ResourceLinking::validateArguments(QString &initiatingAgent,
     }
 
     if (targettedResource.startsWith(QStringLiteral("/"))) {
-        QFileInfo file(targettedResource);
+        const auto canonicalPath = StatsPlugin::self()->canonicalPathCache()
+                                       ->canonicalPath(targettedResource);
 
-        if (!file.exists()) {
+        if (canonicalPath.isEmpty()) {
             qCDebug(KAMD_LOG_RESOURCES) << "Resource is invalid -- the file does not exist";
             return false;
         }
 
-        targettedResource = file.canonicalFilePath();
+        targettedResource = canonicalPath;
     }
 
     // Handling special values for the agent
@@ -307,7 +379,7 @@ void ResourceLinking::onActivityRemoved(const QString &activity)
 
 void ResourceLinking::onCurrentActivityChanged(const QString &activity)
 {
-    Q_UNUSED(activity);
+    SwitchTrace::Handler trace(activity, QStringLiteral("resourcelinking"));
 
     // Notify KIO
     // qCDebug(KAMD_LOG_RESOURCES) << "Changed: activities:/current -> " << activity;
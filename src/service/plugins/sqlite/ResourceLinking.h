@@ -19,6 +19,7 @@
 #define PLUGINS_SQLITE_RESOURCE_LINKING_H
 
 // Qt
+#include <QDBusContext>
 #include <QObject>
 
 // Boost and STL
@@ -37,7 +38,7 @@ class QFileSystemWatcher;
  * - Handles configuration
  * - Filters the events based on the user's configuration.
  */
-class ResourceLinking : public QObject {
+class ResourceLinking : public QObject, protected QDBusContext {
     Q_OBJECT
     Q_CLASSINFO("D-Bus Interface", "org.kde.ActivityManager.Resources.Linking")
 
@@ -88,10 +89,18 @@ private:
 
     QString currentActivity() const;
 
+    // Notifies about the changes after the writer thread saves them
+    void linkedResource(const QString &initiatingAgent,
+                        const QString &targettedResource,
+                        const QString &usedActivity);
+    void unlinkedResource(const QString &initiatingAgent,
+                          const QString &targettedResource,
+                          const QString &usedActivity);
+
+    // These are used only from the writer thread
     std::unique_ptr<QSqlQuery> linkResourceToActivityQuery;
     std::unique_ptr<QSqlQuery> unlinkResourceFromAllActivitiesQuery;
     std::unique_ptr<QSqlQuery> unlinkResourceFromActivityQuery;
-    std::unique_ptr<QSqlQuery> isResourceLinkedToActivityQuery;
 };
 
 #endif // PLUGINS_SQLITE_RESOURCE_LINKING_H
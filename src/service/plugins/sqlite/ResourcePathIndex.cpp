@@ -0,0 +1,277 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "ResourcePathIndex.h"
+
+// Qt
+#include <QHash>
+#include <QSet>
+#include <QSqlQuery>
+#include <QStringList>
+
+// STL
+#include <atomic>
+#include <memory>
+
+// Utils
+#include <utils/d_ptr_implementation.h>
+
+// Local
+#include "Database.h"
+#include "Utils.h"
+
+
+namespace {
+    const int maxCachedNodes = 4096;
+
+    const QStringList referencingTables {
+        QStringLiteral("ResourceEvent"),
+        QStringLiteral("ResourceScoreCache"),
+        QStringLiteral("ResourceLink"),
+        QStringLiteral("ResourceInfo")
+    };
+
+    struct Node {
+        // The root has the id 0, the nodes that do not exist -1
+        qint64 id;
+        QString key;
+    };
+
+    QString normalizedPath(QString path)
+    {
+        while (path.size() > 1 && path.endsWith(QLatin1Char('/'))) {
+            path.chop(1);
+        }
+
+        return path;
+    }
+}
+
+class ResourcePathIndex::Private {
+public:
+    Private()
+        : hitCount(0)
+        , missCount(0)
+    {
+    }
+
+    Node node(const QString &path, bool create);
+
+    QHash<QString, Node> cache;
+
+    std::unique_ptr<QSqlQuery> getNodeQuery;
+    std::unique_ptr<QSqlQuery> insertNodeQuery;
+
+    std::atomic<quint64> hitCount;
+    std::atomic<quint64> missCount;
+};
+
+Node ResourcePathIndex::Private::node(const QString &path, bool create)
+{
+    if (path == QLatin1String("/")) {
+        return Node { 0, QStringLiteral("/") };
+    }
+
+    const auto cached = cache.constFind(path);
+
+    if (cached != cache.cend()) {
+        ++hitCount;
+        return *cached;
+    }
+
+    ++missCount;
+
+    const int slash = path.lastIndexOf(QLatin1Char('/'));
+
+    const auto parent =
+        node(slash == 0 ? QStringLiteral("/") : path.left(slash), create);
+
+    if (parent.id < 0) {
+        return parent;
+    }
+
+    const auto segment = path.mid(slash + 1);
+
+    Utils::prepare(*resourcesDatabase(), getNodeQuery, QStringLiteral(
+        "SELECT id, pathKey FROM ResourcePath "
+        "WHERE parent = :parent AND segment = :segment"
+    ));
+
+    Utils::exec(Utils::FailOnError, *getNodeQuery,
+        ":parent"  , parent.id ,
+        ":segment" , segment
+    );
+
+    Node result { -1, QString() };
+
+    if (getNodeQuery->next()) {
+        result = Node { getNodeQuery->value(0).toLongLong(),
+                        getNodeQuery->value(1).toString() };
+
+    } else if (create) {
+        // The key contains the id of the node itself,
+        // so we are choosing the id in the same query
+        Utils::prepare(*resourcesDatabase(), insertNodeQuery, QStringLiteral(
+            "INSERT INTO ResourcePath (id, parent, segment, pathKey) "
+            "SELECT n.id, :parent, :segment, :parentKey || n.id || '/' "
+            "FROM (SELECT IFNULL(MAX(id), 0) + 1 AS id FROM ResourcePath) n"
+        ));
+
+        Utils::exec(Utils::FailOnError, *insertNodeQuery,
+            ":parent"    , parent.id  ,
+            ":segment"   , segment    ,
+            ":parentKey" , parent.key
+        );
+
+        const auto id = insertNodeQuery->lastInsertId().toLongLong();
+        result = Node { id, parent.key + QString::number(id) + QLatin1Char('/') };
+
+    } else {
+        // Not caching the missing nodes,
+        // they can be created at any time
+        return result;
+    }
+
+    if (cache.size() >= maxCachedNodes) {
+        cache.clear();
+    }
+
+    cache[path] = result;
+
+    return result;
+}
+
+ResourcePathIndex::ResourcePathIndex()
+    : d()
+{
+}
+
+ResourcePathIndex::~ResourcePathIndex()
+{
+}
+
+QVariant ResourcePathIndex::pathId(const QString &resource)
+{
+    if (!resource.startsWith(QLatin1Char('/'))) {
+        return QVariant();
+    }
+
+    const auto node = d->node(normalizedPath(resource), true);
+
+    return node.id > 0 ? QVariant(node.id) : QVariant();
+}
+
+bool ResourcePathIndex::descendantKeys(const QString &directory,
+                                       QString &from, QString &to)
+{
+    if (!directory.startsWith(QLatin1Char('/'))) {
+        return false;
+    }
+
+    const auto node = d->node(normalizedPath(directory), false);
+
+    if (node.id < 0) {
+        return false;
+    }
+
+    // The keys of the descendants are longer than the key of the
+    // directory and start with it. The range ends with the first
+    // key that has a different last separator - '0' comes right
+    // after '/'
+    from = node.key;
+    to = node.key.left(node.key.size() - 1) + QLatin1Char('0');
+
+    return true;
+}
+
+void ResourcePathIndex::fillMissingPaths()
+{
+    auto database = resourcesDatabase();
+
+    if (!database->value(QStringLiteral(
+                "SELECT value FROM SchemaInfo WHERE key = 'resourcePathsFilled'"))
+            .isNull()) {
+        return;
+    }
+
+    DATABASE_TRANSACTION(*database);
+
+    // Splitting each distinct path only once, and then updating every
+    // table in a single pass, instead of looking up the rows per path
+    database->execQuery(QStringLiteral(
+        "CREATE TEMP TABLE IF NOT EXISTS ResourcePathFill ("
+            "targettedResource TEXT PRIMARY KEY, "
+            "targettedPath INTEGER"
+        ")"));
+
+    QSet<QString> resources;
+
+    for (const auto &table: referencingTables) {
+        auto query = database->execQuery(QStringLiteral(
+            "SELECT DISTINCT targettedResource FROM %1 "
+            "WHERE targettedPath IS NULL AND targettedResource LIKE '/%'")
+                .arg(table));
+
+        while (query.next()) {
+            resources << query.value(0).toString();
+        }
+    }
+
+    auto fillQuery = database->createQuery();
+    fillQuery.prepare(QStringLiteral(
+        "INSERT OR IGNORE INTO ResourcePathFill "
+        "VALUES (:targettedResource, :targettedPath)"));
+
+    for (const auto &resource: resources) {
+        Utils::exec(Utils::FailOnError, fillQuery,
+            ":targettedResource" , resource         ,
+            ":targettedPath"     , pathId(resource)
+        );
+    }
+
+    for (const auto &table: referencingTables) {
+        database->execQuery(QStringLiteral(
+            "UPDATE %1 SET targettedPath = ("
+                "SELECT targettedPath FROM ResourcePathFill f "
+                "WHERE f.targettedResource = %1.targettedResource"
+            ") "
+            "WHERE targettedPath IS NULL AND targettedResource LIKE '/%'")
+                .arg(table));
+    }
+
+    fillQuery.finish();
+    database->execQuery(QStringLiteral("DROP TABLE ResourcePathFill"));
+
+    database->execQuery(QStringLiteral(
+        "INSERT OR REPLACE INTO SchemaInfo VALUES ('resourcePathsFilled', '1')"));
+
+    qCDebug(KAMD_LOG_RESOURCES) << "Filled the paths of" << resources.size()
+                                << "resources";
+}
+
+quint64 ResourcePathIndex::hits() const
+{
+    return d->hitCount;
+}
+
+quint64 ResourcePathIndex::misses() const
+{
+    return d->missCount;
+}
@@ -0,0 +1,74 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_RESOURCE_PATH_INDEX_H
+#define PLUGINS_SQLITE_RESOURCE_PATH_INDEX_H
+
+// Qt
+#include <QString>
+#include <QVariant>
+
+// Utils
+#include <utils/d_ptr.h>
+
+/**
+ * Maps the local resources to the nodes of the ResourcePath tree.
+ *
+ * Each node is a single path segment with a reference to its parent.
+ * The recently used nodes are cached, so that the common directories
+ * are looked up only once.
+ *
+ * Not thread-safe, it is meant to be used from the database writer
+ * thread, the only one that can create the nodes.
+ */
+class ResourcePathIndex {
+public:
+    ResourcePathIndex();
+    ~ResourcePathIndex();
+
+    /**
+     * @returns the id of the node for the resource, creating it
+     *     if needed, or a null variant if the resource is not
+     *     a local path. The result can be bound directly to the
+     *     targettedPath columns.
+     */
+    QVariant pathId(const QString &resource);
+
+    /**
+     * Gets the range of the path keys of everything under the
+     * specified directory. The directory itself is not included.
+     * @returns false if there is nothing known under the directory
+     */
+    bool descendantKeys(const QString &directory, QString &from, QString &to);
+
+    /**
+     * Fills the references of the rows that were created before
+     * the ResourcePath table existed. It does nothing if these
+     * were already filled.
+     */
+    void fillMissingPaths();
+
+    quint64 hits() const;
+    quint64 misses() const;
+
+private:
+    D_PTR;
+};
+
+#endif // PLUGINS_SQLITE_RESOURCE_PATH_INDEX_H
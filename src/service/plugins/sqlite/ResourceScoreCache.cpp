@@ -31,6 +31,7 @@
 // Local
 #include "DebugResources.h"
 #include "StatsPlugin.h"
+#include "ResourcePathIndex.h"
 #include "Database.h"
 #include "Utils.h"
 
@@ -47,10 +48,14 @@ private:
         Utils::prepare(*resourcesDatabase(),
             createResourceScoreCacheQuery, QStringLiteral(
             "INSERT INTO ResourceScoreCache "
+                "(usedActivity, initiatingAgent, targettedResource, "
+                 "scoreType, cachedScore, firstUpdate, lastUpdate, "
+                 "targettedPath) "
             "VALUES (:usedActivity, :initiatingAgent, :targettedResource, "
                     "0, 0, " // type, score
                     ":firstUpdate, " // lastUpdate
-                    ":firstUpdate)"
+                    ":firstUpdate, "
+                    ":targettedPath)"
         ));
 
         Utils::prepare(*resourcesDatabase(),
@@ -146,7 +151,7 @@ ResourceScoreCache::~ResourceScoreCache()
 {
 }
 
-void ResourceScoreCache::update()
+void ResourceScoreCache::update(int repeats)
 {
     QDateTime lastUpdate;
     QDateTime firstUpdate;
@@ -163,7 +168,9 @@ void ResourceScoreCache::update()
         ":usedActivity", d->activity,
         ":initiatingAgent", d->application,
         ":targettedResource", d->resource,
-        ":firstUpdate", currentTime.toTime_t()
+        ":firstUpdate", currentTime.toTime_t(),
+        ":targettedPath", StatsPlugin::self()->resourcePathIndex()
+                              ->pathId(d->resource)
     );
 
     // Getting the old score
@@ -232,6 +239,9 @@ void ResourceScoreCache::update()
         }
     }
 
+    // The merged repeats have happened just before this update
+    score += repeats;
+
     qCDebug(KAMD_LOG_RESOURCES) << "         New score : " << score;
 
     // Updating the score
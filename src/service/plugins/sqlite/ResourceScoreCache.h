@@ -38,7 +38,12 @@ public:
                        const QString &resource);
     virtual ~ResourceScoreCache();
 
-    void update();
+    /**
+     * Updates the score from the events stored since the last update.
+     * @param repeats number of accesses that were merged into the stored
+     *     events, each of them is scored like a separate access
+     */
+    void update(int repeats = 0);
 
 private:
     D_PTR;
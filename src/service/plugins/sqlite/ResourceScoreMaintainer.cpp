@@ -21,8 +21,10 @@
 #include "ResourceScoreMaintainer.h"
 
 // Qt
-#include <QList>
+#include <QHash>
 #include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
 
 
 // System
@@ -34,6 +36,7 @@
 
 // Local
 #include "StatsPlugin.h"
+#include "DatabaseExecutor.h"
 #include "ResourceScoreCache.h"
 
 
@@ -47,15 +50,19 @@ public:
 
     typedef QString ApplicationName;
     typedef QString ActivityID;
-    typedef QList<QString> ResourceList;
+    // The resources, with the numbers of merged repeats
+    typedef QHash<QString, int> ResourceList;
 
     typedef QHash<ApplicationName, ResourceList> Applications;
     typedef QHash<ActivityID, Applications> ResourceTree;
 
+    // The resources are scheduled from the writer thread,
+    // while the timer lives in the plugin thread
+    QMutex scheduledResourcesMutex;
     ResourceTree scheduledResources;
 
-    void processActivity(const ActivityID &activity,
-                         const Applications &applications);
+    static void processActivity(const ActivityID &activity,
+                                const Applications &applications);
 
     void processResources();
 
@@ -70,28 +77,38 @@ void ResourceScoreMaintainer::Private::processResources()
 {
     using namespace kamd::utils;
 
-    // initial delay before processing the resources
-    sleep(1);
-
     ResourceTree resources;
 
-    std::swap(resources, scheduledResources);
+    {
+        QMutexLocker lock(&scheduledResourcesMutex);
+        std::swap(resources, scheduledResources);
+    }
+
+    if (resources.isEmpty()) return;
 
     const auto activity = StatsPlugin::self()->currentActivity();
 
+    // The scores are updated in the writer thread, as a single job.
     // Let us first process the events related to the current
     // activity so that the stats are available quicker
+    const auto job = [resources, activity] (Common::Database &) mutable {
+        if (resources.contains(activity)) {
+            processActivity(activity, resources[activity]);
+            resources.remove(activity);
+        }
 
-    if (resources.contains(activity)) {
-        processActivity(activity, resources[activity]);
-        resources.remove(activity);
-    }
+        for_each_assoc(resources,
+            [](const ActivityID & activity, const Applications & applications) {
+                processActivity(activity, applications);
+            }
+        );
 
-    for_each_assoc(resources,
-        [this](const ActivityID & activity, const Applications & applications) {
-            processActivity(activity, applications);
-        }
-    );
+        return QVariant();
+    };
+
+    StatsPlugin::self()->databaseExecutor()->execute(
+        QStringLiteral("UpdateResourceScores"),
+        DatabaseExecutor::Write, DatabaseExecutor::Background, job);
 }
 
 void ResourceScoreMaintainer::Private::processActivity(const ActivityID
@@ -103,8 +120,9 @@ void ResourceScoreMaintainer::Private::processActivity(const ActivityID
 
     for_each_assoc(applications,
         [&](const ApplicationName &application, const ResourceList &resources) {
-            for (const auto &resource : resources) {
-                ResourceScoreCache(activity, application, resource).update();
+            for (auto it = resources.cbegin(); it != resources.cend(); ++it) {
+                ResourceScoreCache(activity, application, it.key())
+                    .update(it.value());
             }
         }
     );
@@ -118,6 +136,8 @@ ResourceScoreMaintainer *ResourceScoreMaintainer::self()
 
 ResourceScoreMaintainer::ResourceScoreMaintainer()
 {
+    // The initial delay before processing the resources,
+    // restarted with each new resource
     d->processResourcesTimer.setInterval(1000);
     d->processResourcesTimer.setSingleShot(true);
     connect(&d->processResourcesTimer, &QTimer::timeout,
@@ -128,14 +148,14 @@ ResourceScoreMaintainer::~ResourceScoreMaintainer()
 {
 }
 
-void ResourceScoreMaintainer::processResource(const QString &resource,
-                                              const QString &application)
+void ResourceScoreMaintainer::processResource(const QString &activity,
+                                              const QString &resource,
+                                              const QString &application,
+                                              int repeats)
 {
     // Checking whether the item is already scheduled for
     // processing
 
-    const auto activity = StatsPlugin::self()->currentActivity();
-
     Q_ASSERT_X(!application.isEmpty(),
                "ResourceScoreMaintainer::processResource",
                "Agent should not be empty");
@@ -143,15 +163,14 @@ void ResourceScoreMaintainer::processResource(const QString &resource,
                "ResourceScoreMaintainer::processResource",
                "Resource should not be empty");
 
-    if (d->scheduledResources.contains(activity)
-        && d->scheduledResources[activity].contains(application)
-        && d->scheduledResources[activity][application].contains(resource)) {
-
-        // Nothing
+    {
+        QMutexLocker lock(&d->scheduledResourcesMutex);
 
-    } else {
-        d->scheduledResources[activity][application] << resource;
+        // If the resource is already scheduled, only the repeats are added
+        d->scheduledResources[activity][application][resource] += repeats;
     }
 
-    d->processResourcesTimer.start();
+    // This is called from the writer thread
+    QMetaObject::invokeMethod(&d->processResourcesTimer, "start",
+                              Qt::QueuedConnection);
 }
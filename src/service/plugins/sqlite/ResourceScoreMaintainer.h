@@ -30,6 +30,8 @@ class QString;
 
 /**
  * ResourceScoreMaintainer represents a queue of resource processing requests.
+ * The resources can be scheduled from any thread, the scores are updated
+ * in the database writer thread.
  */
 class ResourceScoreMaintainer: public QObject {
 public:
@@ -37,7 +39,12 @@ public:
 
     ~ResourceScoreMaintainer() override;
 
-    void processResource(const QString &resource, const QString &application);
+    /**
+     * Schedules the score update for the resource.
+     * @param repeats number of accesses merged into the stored event
+     */
+    void processResource(const QString &activity, const QString &resource,
+                         const QString &application, int repeats = 0);
 
 private:
     ResourceScoreMaintainer();
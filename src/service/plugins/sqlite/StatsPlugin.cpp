@@ -22,30 +22,41 @@
 #include "StatsPlugin.h"
 
 // Qt
+#include <QElapsedTimer>
 #include <QFileSystemWatcher>
 #include <QSqlQuery>
 #include <QStringList>
+#include <QUrl>
 
 // KDE
 #include <kconfig.h>
 #include <kdbusconnectionpool.h>
-#include <kfileitem.h>
 
 // Boost
 #include <boost/range/algorithm/binary_search.hpp>
-#include <utils/range.h>
 
 // Local
 #include "Database.h"
 #include "ResourceScoreMaintainer.h"
 #include "ResourceLinking.h"
+#include "CanonicalPathCache.h"
+#include "ResourceInfoWriter.h"
+#include "ResourcePathIndex.h"
+#include "DatabaseExecutor.h"
+#include <common/database/DatabasePool.h>
 #include "Utils.h"
 #include "../../Event.h"
+#include <ActivitiesSnapshot.h>
 #include "resourcescoringadaptor.h"
 #include "common/specialvalues.h"
 
 KAMD_EXPORT_PLUGIN(sqliteplugin, StatsPlugin, "kactivitymanagerd-plugin-sqlite.json")
 
+namespace {
+    // The looked up resources are forgotten after this many
+    const int maxInfoLookedUp = 10000;
+}
+
 StatsPlugin *StatsPlugin::s_instance = nullptr;
 
 StatsPlugin::StatsPlugin(QObject *parent, const QVariantList &args)
@@ -53,6 +64,10 @@ StatsPlugin::StatsPlugin(QObject *parent, const QVariantList &args)
     , m_activities(nullptr)
     , m_resources(nullptr)
     , m_resourceLinking(new ResourceLinking(this))
+    , m_pathCache(new CanonicalPathCache(this))
+    , m_infoDetector(new ResourceInfoDetector(this))
+    , m_infoWriter(new ResourceInfoWriter(this))
+    , m_pathIndex(new ResourcePathIndex())
 {
     Q_UNUSED(args);
     s_instance = this;
@@ -62,16 +77,40 @@ StatsPlugin::StatsPlugin(QObject *parent, const QVariantList &args)
         QStringLiteral("/ActivityManager/Resources/Scoring"), this);
 
     setName(QStringLiteral("org.kde.ActivityManager.Resources.Scoring"));
+
+    // The name needs to be set to read the configuration
+    m_executor.reset(new DatabaseExecutor(
+        config().readEntry("database-readers", 2)));
+}
+
+StatsPlugin::~StatsPlugin()
+{
+    // The writer needs the path index, which is
+    // destroyed before the children of the plugin.
+    // The executor finishes the queued writes
+    // before it is destroyed
+    m_infoWriter->flush();
 }
 
 bool StatsPlugin::init(QHash<QString, QObject *> &modules)
 {
     Plugin::init(modules);
 
-    if (!resourcesDatabase()) {
+    if (!m_executor->waitForDatabase()) {
         return false;
     }
 
+    m_executor->execute(QStringLiteral("FillMissingPaths"),
+                        DatabaseExecutor::Write, DatabaseExecutor::Normal,
+                        [this] (Common::Database &) {
+                            m_pathIndex->fillMissingPaths();
+                            return QVariant();
+                        });
+
+    // The maintainer needs to live in this thread,
+    // it is fed from the writer thread
+    ResourceScoreMaintainer::self();
+
     m_activities = modules[QStringLiteral("activities")];
     m_resources = modules[QStringLiteral("resources")];
 
@@ -87,6 +126,9 @@ bool StatsPlugin::init(QHash<QString, QObject *> &modules)
     connect(modules[QStringLiteral("config")], SIGNAL(pluginConfigChanged()),
             this, SLOT(loadConfiguration()));
 
+    connect(m_infoDetector, &ResourceInfoDetector::detected,
+            this, &StatsPlugin::saveDetectedResourceInfo);
+
     loadConfiguration();
 
     return true;
@@ -125,8 +167,6 @@ void StatsPlugin::loadConfiguration()
             this, &StatsPlugin::deleteOldEvents);
 
     // Loading URL filters
-    m_urlFilters.clear();
-
     auto filters = conf.readEntry("url-filters",
             QStringList() << "about:*" // Ignore about: stuff
                           << "*/.*"    // Ignore hidden files
@@ -134,12 +174,17 @@ void StatsPlugin::loadConfiguration()
                           << "/tmp/*"  // Ignore everything in /tmp
             );
 
-    for (const auto& filter: filters) {
-        m_urlFilters << Common::starPatternToRegex(filter);
-    }
+    m_urlFilter = UrlFilterMatcher(filters);
 
     // Loading the private activities
     m_otrActivities = conf.readEntry("off-the-record-activities", QStringList());
+
+    // Zero disables the caching of canonical paths
+    m_pathCache->setCapacity(conf.readEntry("canonical-path-cache-size", 4096));
+    m_pathCache->setDirectoryCapacity(
+        conf.readEntry("canonical-path-cache-directories", 256));
+
+    m_infoDetector->setThreadCount(conf.readEntry("metadata-detection-threads", 2));
 }
 
 void StatsPlugin::deleteOldEvents()
@@ -163,12 +208,10 @@ void StatsPlugin::openResourceEvent(const QString &usedActivity,
                "StatsPlugin::openResourceEvent",
                "Resource should not be empty");
 
-    detectResourceInfo(targettedResource);
-
     Utils::prepare(*resourcesDatabase(), openResourceEventQuery, QStringLiteral(
         "INSERT INTO ResourceEvent"
-        "        (usedActivity,  initiatingAgent,  targettedResource,  start,  end) "
-        "VALUES (:usedActivity, :initiatingAgent, :targettedResource, :start, :end)"
+        "        (usedActivity,  initiatingAgent,  targettedResource,  start,  end,  targettedPath) "
+        "VALUES (:usedActivity, :initiatingAgent, :targettedResource, :start, :end, :targettedPath)"
     ));
 
     Utils::exec(Utils::FailOnError, *openResourceEventQuery,
@@ -176,7 +219,8 @@ void StatsPlugin::openResourceEvent(const QString &usedActivity,
         ":initiatingAgent"   , initiatingAgent   ,
         ":targettedResource" , targettedResource ,
         ":start"             , start.toTime_t()  ,
-        ":end"               , (end.isNull()) ? QVariant() : end.toTime_t()
+        ":end"               , (end.isNull()) ? QVariant() : end.toTime_t(),
+        ":targettedPath"     , m_pathIndex->pathId(targettedResource)
     );
 }
 
@@ -213,107 +257,65 @@ void StatsPlugin::closeResourceEvent(const QString &usedActivity,
     );
 }
 
-void StatsPlugin::detectResourceInfo(const QString &_uri)
+void StatsPlugin::detectResourceInfo(const QString &uri)
 {
-    const QUrl uri = QUrl::fromUserInput(_uri);
+    // Only the local files can be detected
+    if (!QUrl::fromUserInput(uri).isLocalFile()) return;
 
-    if (!uri.isLocalFile()) return;
+    if (m_infoLookedUp.contains(uri)) return;
 
-    const QString file = uri.toLocalFile();
+    if (m_infoLookedUp.size() >= maxInfoLookedUp) {
+        m_infoLookedUp.clear();
+    }
 
-    if (!QFile::exists(file)) return;
+    m_infoLookedUp << uri;
 
-    KFileItem item(uri);
+    const auto job = [=] (Common::Database &database) {
+        // The query is not cached, the job can be executed
+        // in any of the reader threads
+        auto query = database.createQuery();
+        query.prepare(QStringLiteral(
+            "SELECT targettedResource FROM ResourceInfo WHERE "
+                "  targettedResource = :targettedResource "
+        ));
 
-    if (insertResourceInfo(file)) {
-        saveResourceMimetype(file, item.mimetype(), true);
+        Utils::exec(Utils::FailOnError, query,
+            ":targettedResource", uri
+        );
 
-        const auto text = item.text();
-        saveResourceTitle(file, text.isEmpty() ? _uri : text, true);
-    }
+        return QVariant(query.next());
+    };
+
+    // The resources that already have their info are not detected
+    // again. This only schedules the detection, the results are
+    // saved by saveDetectedResourceInfo
+    m_executor->execute(QStringLiteral("ResourceInfoLookup"),
+                        DatabaseExecutor::Read, DatabaseExecutor::Background, job,
+                        [=] (const QVariant &known) {
+                            if (!known.toBool()) {
+                                m_infoDetector->detect(uri);
+                            }
+                        });
 }
 
-bool StatsPlugin::insertResourceInfo(const QString &uri)
+void StatsPlugin::saveDetectedResourceInfo(
+        const QList<ResourceInfoDetector::Info> &batch)
 {
-
-    Utils::prepare(*resourcesDatabase(), getResourceInfoQuery, QStringLiteral(
-        "SELECT targettedResource FROM ResourceInfo WHERE "
-            "  targettedResource = :targettedResource "
-    ));
-
-    getResourceInfoQuery->bindValue(":targettedResource", uri);
-    Utils::exec(Utils::FailOnError, *getResourceInfoQuery);
-
-    if (getResourceInfoQuery->next()) {
-        return false;
+    for (const auto &info: batch) {
+        m_infoWriter->setDetectedInfo(info.file, info.title, info.mimetype);
     }
-
-    Utils::prepare(*resourcesDatabase(), insertResourceInfoQuery, QStringLiteral(
-        "INSERT INTO ResourceInfo( "
-            "  targettedResource"
-            ", title"
-            ", autoTitle"
-            ", mimetype"
-            ", autoMimetype"
-        ") VALUES ("
-            "  :targettedResource"
-            ", '' "
-            ", 1 "
-            ", '' "
-            ", 1 "
-        ")"
-    ));
-
-    Utils::exec(Utils::FailOnError, *insertResourceInfoQuery,
-        ":targettedResource", uri
-    );
-
-    return true;
 }
 
-void StatsPlugin::saveResourceTitle(const QString &uri, const QString &title,
-                                    bool autoTitle)
+void StatsPlugin::saveResourceTitle(const QString &uri, const QString &title)
 {
-    insertResourceInfo(uri);
-
-    DATABASE_TRANSACTION(*resourcesDatabase());
-
-    Utils::prepare(*resourcesDatabase(), saveResourceTitleQuery, QStringLiteral(
-        "UPDATE ResourceInfo SET "
-            "  title = :title"
-            ", autoTitle = :autoTitle "
-        "WHERE "
-            "targettedResource = :targettedResource "
-    ));
-
-    Utils::exec(Utils::FailOnError, *saveResourceTitleQuery,
-        ":targettedResource" , uri                     ,
-        ":title"             , title                   ,
-        ":autoTitle"         , (autoTitle ? "1" : "0")
-    );
+    // The writer collects the changes and saves them in batches
+    m_infoWriter->setTitle(uri, title);
 }
 
 void StatsPlugin::saveResourceMimetype(const QString &uri,
-                                       const QString &mimetype,
-                                       bool autoMimetype)
+                                       const QString &mimetype)
 {
-    insertResourceInfo(uri);
-
-    DATABASE_TRANSACTION(*resourcesDatabase());
-
-    Utils::prepare(*resourcesDatabase(), saveResourceMimetypeQuery, QStringLiteral(
-        "UPDATE ResourceInfo SET "
-            "  mimetype = :mimetype"
-            ", autoMimetype = :autoMimetype "
-        "WHERE "
-            "targettedResource = :targettedResource "
-    ));
-
-    Utils::exec(Utils::FailOnError, *saveResourceMimetypeQuery,
-        ":targettedResource" , uri                        ,
-        ":mimetype"          , mimetype                   ,
-        ":autoMimetype"      , (autoMimetype ? "1" : "0")
-    );
+    m_infoWriter->setMimetype(uri, mimetype);
 }
 
 
@@ -324,20 +326,15 @@ StatsPlugin *StatsPlugin::self()
 
 bool StatsPlugin::acceptedEvent(const Event &event)
 {
-    using std::bind;
-    using std::any_of;
-    using namespace std::placeholders;
-
     return !(
         // If the URI is empty, we do not want to process it
         event.uri.isEmpty() ||
 
-        // Skip if the current activity is OTR
-        m_otrActivities.contains(currentActivity()) ||
+        // Skip if the activity of the event is OTR
+        m_otrActivities.contains(event.activity) ||
 
         // Exclude URIs that match the ignored patterns
-        any_of(m_urlFilters.cbegin(), m_urlFilters.cend(),
-               bind(&QRegExp::exactMatch, _1, event.uri)) ||
+        m_urlFilter.matches(event.uri) ||
 
         // if blocked by default, the list contains allowed applications
         //     ignore event if the list doesn't contain the application
@@ -351,14 +348,19 @@ bool StatsPlugin::acceptedEvent(const Event &event)
 
 Event StatsPlugin::validateEvent(Event event)
 {
+    // The events that were not created by Resources
+    // belong to the current activity
+    if (event.activity.isEmpty()) {
+        event.activity = currentActivity();
+    }
+
     if (event.uri.startsWith(QStringLiteral("file://"))) {
         event.uri = QUrl(event.uri).toLocalFile();
     }
 
     if (event.uri.startsWith(QStringLiteral("/"))) {
-        QFileInfo file(event.uri);
-
-        event.uri = file.exists() ? file.canonicalFilePath() : QString();
+        // Empty if the file does not exist
+        event.uri = m_pathCache->canonicalPath(event.uri);
     }
 
     return event;
@@ -366,145 +368,203 @@ Event StatsPlugin::validateEvent(Event event)
 
 QStringList StatsPlugin::listActivities() const
 {
-    return Plugin::retrieve<QStringList>(
-                m_activities, "ListActivities", "QStringList");
+    return ActivitiesSnapshot::current()->activities;
 }
 
 QString StatsPlugin::currentActivity() const
 {
-    return Plugin::retrieve<QString>(
-                m_activities, "CurrentActivity", "QString");
+    return ActivitiesSnapshot::current()->currentActivity;
 }
 
 
 
 void StatsPlugin::addEvents(const EventList &events)
 {
-    using namespace kamd::utils;
-
     if (m_blockAll || m_whatToRemember == NoApplications) {
         return;
     }
 
-    const auto &eventsToProcess =
-        events | transformed(&StatsPlugin::validateEvent, this)
-               | filtered(&StatsPlugin::acceptedEvent, this);
-
-    if (eventsToProcess.begin() == eventsToProcess.end()) return;
+    QElapsedTimer timer;
+    timer.start();
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+    qint64 validationTime = 0;
+    qint64 filteringTime = 0;
 
-    for (auto event : eventsToProcess) {
+    // Every event is validated and filtered exactly once,
+    // the validation of local files is not cheap
+    m_eventsToProcess.clear();
 
-        switch (event.type) {
-            case Event::Accessed:
-                openResourceEvent(
-                    currentActivity(), event.application, event.uri,
-                    event.timestamp, event.timestamp);
-                ResourceScoreMaintainer::self()->processResource(
-                    event.uri, event.application);
+    for (const auto &event: events) {
+        const auto validationStart = timer.nsecsElapsed();
 
-                break;
+        auto validated = validateEvent(event);
 
-            case Event::Opened:
-                openResourceEvent(
-                    currentActivity(), event.application, event.uri,
-                    event.timestamp);
+        const auto filteringStart = timer.nsecsElapsed();
 
-                break;
+        if (acceptedEvent(validated)) {
+            m_eventsToProcess.push_back(std::move(validated));
+        }
 
-            case Event::Closed:
-                closeResourceEvent(
-                    currentActivity(), event.application, event.uri,
-                    event.timestamp);
-                ResourceScoreMaintainer::self()->processResource(
-                    event.uri, event.application);
+        validationTime += filteringStart - validationStart;
+        filteringTime += timer.nsecsElapsed() - filteringStart;
+    }
 
-                break;
+    m_pipeline.events += events.size();
+    m_pipeline.acceptedEvents += m_eventsToProcess.size();
+    m_pipeline.validationTime += validationTime;
+    m_pipeline.filteringTime += filteringTime;
 
-            case Event::UserEventType:
-                ResourceScoreMaintainer::self()->processResource(
-                    event.uri, event.application);
-                break;
+    if (m_eventsToProcess.empty()) return;
 
-            default:
-                // Nothing yet
-                // TODO: Add focus and modification
-                break;
+    for (const auto &event: m_eventsToProcess) {
+        if (event.type == Event::Accessed || event.type == Event::Opened) {
+            detectResourceInfo(event.uri);
         }
     }
+
+    // The events are stored in the writer thread, the batch is handed
+    // over to it, and a new one is started for the next call
+    std::shared_ptr<std::vector<Event>> batch(new std::vector<Event>());
+    std::swap(*batch, m_eventsToProcess);
+
+    const auto job = [this, batch] (Common::Database &database) {
+        QElapsedTimer timer;
+        timer.start();
+
+        {
+            DATABASE_TRANSACTION(database);
+
+            for (const auto &event: *batch) {
+                switch (event.type) {
+                    case Event::Accessed:
+                        openResourceEvent(
+                            event.activity, event.application, event.uri,
+                            event.timestamp, event.timestamp);
+                        ResourceScoreMaintainer::self()->processResource(
+                            event.activity, event.uri, event.application,
+                            event.repeatCount - 1);
+
+                        break;
+
+                    case Event::Opened:
+                        openResourceEvent(
+                            event.activity, event.application, event.uri,
+                            event.timestamp);
+
+                        break;
+
+                    case Event::Closed:
+                        closeResourceEvent(
+                            event.activity, event.application, event.uri,
+                            event.timestamp);
+                        ResourceScoreMaintainer::self()->processResource(
+                            event.activity, event.uri, event.application);
+
+                        break;
+
+                    case Event::UserEventType:
+                        ResourceScoreMaintainer::self()->processResource(
+                            event.activity, event.uri, event.application);
+                        break;
+
+                    default:
+                        // Nothing yet
+                        // TODO: Add focus and modification
+                        break;
+                }
+            }
+        }
+
+        m_pipeline.storingTime += timer.nsecsElapsed();
+
+        return QVariant();
+    };
+
+    m_executor->execute(QStringLiteral("StoreEvents"),
+                        DatabaseExecutor::Write, DatabaseExecutor::Normal, job);
 }
 
 void StatsPlugin::DeleteRecentStats(const QString &activity, int count,
                                     const QString &what)
 {
+    const DatabaseExecutor::DelayedReply reply(this);
+
     const auto usedActivity = activity.isEmpty() ? QVariant()
                                                  : QVariant(activity);
 
-    // If we need to delete everything,
-    // no need to bother with the count and the date
+    const auto job = [=] (Common::Database &database) {
+        // If we need to delete everything,
+        // no need to bother with the count and the date
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+        DATABASE_TRANSACTION(database);
 
-    if (what == QStringLiteral("everything")) {
-        // Instantiating these every time is not a big overhead
-        // since this method is rarely executed.
+        if (what == QStringLiteral("everything")) {
+            // Instantiating these every time is not a big overhead
+            // since this method is rarely executed.
 
-        auto removeEventsQuery = resourcesDatabase()->createQuery();
-        removeEventsQuery.prepare(
-                "DELETE FROM ResourceEvent "
-                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity)"
-            );
+            auto removeEventsQuery = database.createQuery();
+            removeEventsQuery.prepare(
+                    "DELETE FROM ResourceEvent "
+                    "WHERE usedActivity = COALESCE(:usedActivity, usedActivity)"
+                );
 
-        auto removeScoreCachesQuery = resourcesDatabase()->createQuery();
-        removeScoreCachesQuery.prepare(
-                "DELETE FROM ResourceScoreCache "
-                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity)");
+            auto removeScoreCachesQuery = database.createQuery();
+            removeScoreCachesQuery.prepare(
+                    "DELETE FROM ResourceScoreCache "
+                    "WHERE usedActivity = COALESCE(:usedActivity, usedActivity)");
 
-        Utils::exec(Utils::FailOnError, removeEventsQuery, ":usedActivity", usedActivity);
-        Utils::exec(Utils::FailOnError, removeScoreCachesQuery, ":usedActivity", usedActivity);
+            Utils::exec(Utils::FailOnError, removeEventsQuery, ":usedActivity", usedActivity);
+            Utils::exec(Utils::FailOnError, removeScoreCachesQuery, ":usedActivity", usedActivity);
 
-    } else {
+        } else {
 
-        // Deleting a specified length of time
+            // Deleting a specified length of time
 
-        auto since = QDateTime::currentDateTime();
+            auto since = QDateTime::currentDateTime();
 
-        since = (what[0] == QLatin1Char('h')) ? since.addSecs(-count * 60 * 60)
-              : (what[0] == QLatin1Char('d')) ? since.addDays(-count)
-              : (what[0] == QLatin1Char('m')) ? since.addMonths(-count)
-              : since;
+            since = (what[0] == QLatin1Char('h')) ? since.addSecs(-count * 60 * 60)
+                  : (what[0] == QLatin1Char('d')) ? since.addDays(-count)
+                  : (what[0] == QLatin1Char('m')) ? since.addMonths(-count)
+                  : since;
 
-        // Maybe we should decrease the scores for the previously
-        // cached items. Thinking it is not that important -
-        // if something was accessed before, and the user did not
-        // remove the history, it is not really a secret.
+            // Maybe we should decrease the scores for the previously
+            // cached items. Thinking it is not that important -
+            // if something was accessed before, and the user did not
+            // remove the history, it is not really a secret.
 
-        auto removeEventsQuery = resourcesDatabase()->createQuery();
-        removeEventsQuery.prepare(
-                "DELETE FROM ResourceEvent "
-                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
-                "AND end > :since"
-            );
+            auto removeEventsQuery = database.createQuery();
+            removeEventsQuery.prepare(
+                    "DELETE FROM ResourceEvent "
+                    "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
+                    "AND end > :since"
+                );
 
-        auto removeScoreCachesQuery = resourcesDatabase()->createQuery();
-        removeScoreCachesQuery.prepare(
-                "DELETE FROM ResourceScoreCache "
-                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
-                "AND firstUpdate > :since");
+            auto removeScoreCachesQuery = database.createQuery();
+            removeScoreCachesQuery.prepare(
+                    "DELETE FROM ResourceScoreCache "
+                    "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
+                    "AND firstUpdate > :since");
 
-        Utils::exec(Utils::FailOnError, removeEventsQuery,
-                ":usedActivity", usedActivity,
-                ":since", since.toTime_t()
-            );
+            Utils::exec(Utils::FailOnError, removeEventsQuery,
+                    ":usedActivity", usedActivity,
+                    ":since", since.toTime_t()
+                );
 
-        Utils::exec(Utils::FailOnError, removeScoreCachesQuery,
-                ":usedActivity", usedActivity,
-                ":since", since.toTime_t()
-            );
-    }
+            Utils::exec(Utils::FailOnError, removeScoreCachesQuery,
+                    ":usedActivity", usedActivity,
+                    ":since", since.toTime_t()
+                );
+        }
+
+        return QVariant();
+    };
 
-    emit RecentStatsDeleted(activity, count, what);
+    m_executor->execute(QStringLiteral("DeleteRecentStats"),
+                        DatabaseExecutor::Write, DatabaseExecutor::Normal, job,
+                        [=] (const QVariant &) {
+                            emit RecentStatsDeleted(activity, count, what);
+                            reply.send();
+                        });
 }
 
 void StatsPlugin::DeleteEarlierStats(const QString &activity, int months)
@@ -513,38 +573,68 @@ void StatsPlugin::DeleteEarlierStats(const QString &activity, int months)
         return;
     }
 
-    // Deleting a specified length of time
+    const DatabaseExecutor::DelayedReply reply(this);
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+    // Deleting a specified length of time
 
     const auto time = QDateTime::currentDateTime().addMonths(-months);
     const auto usedActivity = activity.isEmpty() ? QVariant()
                                                  : QVariant(activity);
 
-    auto removeEventsQuery = resourcesDatabase()->createQuery();
-    removeEventsQuery.prepare(
-            "DELETE FROM ResourceEvent "
-            "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
-            "AND start < :time"
-        );
+    const auto job = [=] (Common::Database &database) {
+        DATABASE_TRANSACTION(database);
 
-    auto removeScoreCachesQuery = resourcesDatabase()->createQuery();
-    removeScoreCachesQuery.prepare(
-            "DELETE FROM ResourceScoreCache "
-            "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
-            "AND lastUpdate < :time");
+        auto removeEventsQuery = database.createQuery();
+        removeEventsQuery.prepare(
+                "DELETE FROM ResourceEvent "
+                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
+                "AND start < :time"
+            );
 
-    Utils::exec(Utils::FailOnError, removeEventsQuery,
-            ":usedActivity", usedActivity,
-            ":time", time.toTime_t()
-        );
+        auto removeScoreCachesQuery = database.createQuery();
+        removeScoreCachesQuery.prepare(
+                "DELETE FROM ResourceScoreCache "
+                "WHERE usedActivity = COALESCE(:usedActivity, usedActivity) "
+                "AND lastUpdate < :time");
 
-    Utils::exec(Utils::FailOnError, removeScoreCachesQuery,
-            ":usedActivity", usedActivity,
-            ":time", time.toTime_t()
-        );
+        Utils::exec(Utils::FailOnError, removeEventsQuery,
+                ":usedActivity", usedActivity,
+                ":time", time.toTime_t()
+            );
+
+        Utils::exec(Utils::FailOnError, removeScoreCachesQuery,
+                ":usedActivity", usedActivity,
+                ":time", time.toTime_t()
+            );
+
+        return QVariant();
+    };
 
-    emit EarlierStatsDeleted(activity, months);
+    // This is also the periodic cleanup, it can wait
+    m_executor->execute(QStringLiteral("DeleteEarlierStats"),
+                        DatabaseExecutor::Write, DatabaseExecutor::Background, job,
+                        [=] (const QVariant &) {
+                            emit EarlierStatsDeleted(activity, months);
+                            reply.send();
+                        });
+}
+
+namespace {
+    // The first string that is greater than all the strings starting
+    // with the prefix, in the order of the code points (that is how
+    // sqlite compares the UTF-8 strings), or an empty string if we
+    // can not increment the last character
+    QString prefixUpperBound(const QString &prefix)
+    {
+        if (prefix.isEmpty()) return QString();
+
+        const auto last = prefix.at(prefix.size() - 1).unicode();
+
+        if (QChar::isSurrogate(last) || last == 0xFFFF) return QString();
+
+        return prefix.left(prefix.size() - 1)
+               + QChar(last == 0xD7FF ? 0xE000 : last + 1);
+    }
 }
 
 void StatsPlugin::DeleteStatsForResource(const QString &activity,
@@ -564,53 +654,105 @@ void StatsPlugin::DeleteStatsForResource(const QString &activity,
                "StatsPlugin::DeleteStatsForResource",
                "We can not handle CURRENT_AGENT_TAG here");
 
-    DATABASE_TRANSACTION(*resourcesDatabase());
+    const DatabaseExecutor::DelayedReply reply(this);
 
-    // Check against sql injection
-    if (activity.contains('\'') || client.contains('\'')) return;
+    QStringList conditions;
+    QVariantMap values;
 
-    const auto activityFilter =
-            activity == ANY_ACTIVITY_TAG ? " 1 " :
-                QStringLiteral(" usedActivity = '%1' ").arg(
-                    activity == CURRENT_ACTIVITY_TAG ?
-                            currentActivity() : activity
-                );
+    if (activity != ANY_ACTIVITY_TAG) {
+        conditions << QStringLiteral("usedActivity = :usedActivity");
+        values[QStringLiteral(":usedActivity")] =
+            activity == CURRENT_ACTIVITY_TAG ? currentActivity() : activity;
+    }
 
-    const auto clientFilter =
-            client == ANY_AGENT_TAG ? " 1 " :
-                QStringLiteral(" initiatingAgent = '%1' ").arg(client);
-
-    auto removeEventsQuery = resourcesDatabase()->createQuery();
-    removeEventsQuery.prepare(
-            "DELETE FROM ResourceEvent "
-            "WHERE "
-                + activityFilter + " AND "
-                + clientFilter + " AND "
-                + "targettedResource LIKE :targettedResource ESCAPE '\\'"
-        );
+    if (client != ANY_AGENT_TAG) {
+        conditions << QStringLiteral("initiatingAgent = :initiatingAgent");
+        values[QStringLiteral(":initiatingAgent")] = client;
+    }
 
-    auto removeScoreCachesQuery = resourcesDatabase()->createQuery();
-    removeScoreCachesQuery.prepare(
-            "DELETE FROM ResourceScoreCache "
-            "WHERE "
-                + activityFilter + " AND "
-                + clientFilter + " AND "
-                + "targettedResource LIKE :targettedResource ESCAPE '\\'"
-        );
+    // The patterns without escapes that have no stars, or just the
+    // trailing one, can be matched with the indices. The rest
+    // needs to scan the table with LIKE.
+    const int stars = resource.count(QLatin1Char('*'));
+    const bool isSimplePattern = !resource.contains(QLatin1Char('\\'))
+        && (stars == 0 || (stars == 1 && resource.endsWith(QLatin1Char('*'))));
+
+    const auto prefix = resource.left(resource.size() - stars);
+    const auto prefixEnd = isSimplePattern && stars == 1
+                               ? prefixUpperBound(prefix) : QString();
+
+    // There are only a few combinations of the conditions,
+    // each of them gets its own prepared statement.
+    // The path index belongs to the writer thread, so the
+    // resource conditions are chosen in the job
+    const auto job = [=] (Common::Database &database) mutable {
+        QString fromKey, toKey;
+
+        if (isSimplePattern && stars == 0) {
+            conditions << QStringLiteral("targettedResource = :targettedResource");
+            values[QStringLiteral(":targettedResource")] = resource;
+
+        } else if (isSimplePattern && prefix.endsWith(QLatin1Char('/'))
+                   && m_pathIndex->descendantKeys(prefix, fromKey, toKey)) {
+            // Everything under a local directory, found through the keys
+            // of the path tree
+            conditions << QStringLiteral("targettedPath IN ("
+                              "SELECT id FROM ResourcePath "
+                              "WHERE pathKey > :fromKey AND pathKey < :toKey)");
+            values[QStringLiteral(":fromKey")] = fromKey;
+            values[QStringLiteral(":toKey")] = toKey;
+
+        } else if (!prefixEnd.isEmpty()) {
+            conditions << QStringLiteral("targettedResource >= :prefix "
+                                         "AND targettedResource < :prefixEnd");
+            values[QStringLiteral(":prefix")] = prefix;
+            values[QStringLiteral(":prefixEnd")] = prefixEnd;
+
+        } else {
+            conditions << QStringLiteral(
+                "targettedResource LIKE :targettedResource ESCAPE '\\'");
+            values[QStringLiteral(":targettedResource")] =
+                Common::starPatternToLike(resource);
+        }
+
+        DATABASE_TRANSACTION(database);
 
-    const auto pattern = Common::starPatternToLike(resource);
+        const auto deleteFrom = [&] (const QString &table) {
+            const auto queryString = QStringLiteral("DELETE FROM %1 WHERE %2")
+                .arg(table, conditions.join(QStringLiteral(" AND ")));
 
-    Utils::exec(Utils::FailOnError, removeEventsQuery,
-                ":targettedResource", pattern);
+            auto &query = m_deleteStatsForResourceQueries[queryString];
+            Utils::prepare(database, query, queryString);
 
-    Utils::exec(Utils::FailOnError, removeScoreCachesQuery,
-                ":targettedResource", pattern);
+            for (auto it = values.cbegin(); it != values.cend(); ++it) {
+                query->bindValue(it.key(), it.value());
+            }
 
-    emit ResourceScoreDeleted(activity, client, resource);
+            Utils::exec(Utils::FailOnError, *query);
+        };
+
+        deleteFrom(QStringLiteral("ResourceEvent"));
+        deleteFrom(QStringLiteral("ResourceScoreCache"));
+
+        return QVariant();
+    };
+
+    m_executor->execute(QStringLiteral("DeleteStatsForResource"),
+                        DatabaseExecutor::Write, DatabaseExecutor::Normal, job,
+                        [=] (const QVariant &) {
+                            emit ResourceScoreDeleted(activity, client, resource);
+                            reply.send();
+                        });
 }
 
 bool StatsPlugin::isFeatureOperational(const QStringList &feature) const
 {
+    if (feature[0] == "pathCache" || feature[0] == "pipeline"
+        || feature[0] == "resourceInfo" || feature[0] == "resourcePaths"
+        || feature[0] == "databaseExecutor" || feature[0] == "databasePool") {
+        return true;
+    }
+
     if (feature[0] == "isOTR") {
         if (feature.size() != 2) return true;
 
@@ -664,6 +806,114 @@ bool StatsPlugin::isFeatureOperational(const QStringList &feature) const
 
 QDBusVariant StatsPlugin::featureValue(const QStringList &feature) const
 {
+    if (feature[0] == "pipeline") {
+        if (feature.size() != 2) return QDBusVariant();
+
+        if (feature[1] == "pendingWrites") {
+            return QDBusVariant((qulonglong)m_executor->pendingWrites());
+        }
+
+        // The times are cumulative, in nanoseconds
+        const std::atomic<quint64> *counter =
+            feature[1] == "events"         ? &m_pipeline.events :
+            feature[1] == "acceptedEvents" ? &m_pipeline.acceptedEvents :
+            feature[1] == "validationTime" ? &m_pipeline.validationTime :
+            feature[1] == "filteringTime"  ? &m_pipeline.filteringTime :
+            feature[1] == "storingTime"    ? &m_pipeline.storingTime :
+                                             nullptr;
+
+        return counter ? QDBusVariant((qulonglong)counter->load())
+                       : QDBusVariant();
+    }
+
+    if (feature[0] == "resourceInfo") {
+        if (feature.size() != 2) return QDBusVariant();
+
+        const auto value =
+            feature[1] == "pending"         ? m_infoDetector->pending() :
+            feature[1] == "detected"        ? m_infoDetector->detectedCount() :
+            feature[1] == "cacheHits"       ? m_infoDetector->cacheHits() :
+            feature[1] == "updates"         ? m_infoWriter->updates() :
+            feature[1] == "writes"          ? m_infoWriter->statements() :
+            feature[1] == "statementsSaved" ? m_infoWriter->statementsSaved() :
+            feature[1] == "lastBatchStatementsSaved"
+                                            ? m_infoWriter->lastBatchStatementsSaved() :
+                                              0;
+
+        return QDBusVariant((qulonglong)value);
+    }
+
+    if (feature[0] == "databasePool") {
+        if (feature.size() != 2) return QDBusVariant();
+
+        const auto &pool = m_executor->readerPool();
+
+        if (feature[1] == "size") {
+            return QDBusVariant(pool.size());
+
+        } else if (feature[1] == "jobs") {
+            return QDBusVariant((qulonglong)pool.jobs());
+
+        } else if (feature[1] == "waitTime") {
+            return QDBusVariant((qulonglong)pool.waitTime());
+
+        } else if (feature[1] == "utilization") {
+            return QDBusVariant(pool.utilization());
+        }
+
+        return QDBusVariant();
+    }
+
+    if (feature[0] == "databaseExecutor") {
+        if (feature.size() != 3) return QDBusVariant();
+
+        // The latencies are in microseconds
+        const auto statistics = m_executor->statistics(feature[1]);
+
+        const auto value =
+            feature[2] == "calls"      ? statistics.calls :
+            feature[2] == "queueTime"  ? statistics.queueTime :
+            feature[2] == "runTime"    ? statistics.runTime :
+            feature[2] == "maxLatency" ? statistics.maxLatency :
+                                         0;
+
+        return QDBusVariant((qulonglong)value);
+    }
+
+    if (feature[0] == "resourcePaths") {
+        if (feature.size() != 2) return QDBusVariant();
+
+        const auto value =
+            feature[1] == "hits"   ? m_pathIndex->hits() :
+            feature[1] == "misses" ? m_pathIndex->misses() :
+                                     0;
+
+        return QDBusVariant((qulonglong)value);
+    }
+
+    if (feature[0] == "pathCache") {
+        if (feature.size() != 2) return QDBusVariant();
+
+        const auto hits = m_pathCache->hits();
+        const auto misses = m_pathCache->misses();
+
+        if (feature[1] == "hits") {
+            return QDBusVariant((qulonglong)hits);
+
+        } else if (feature[1] == "misses") {
+            return QDBusVariant((qulonglong)misses);
+
+        } else if (feature[1] == "invalidations") {
+            return QDBusVariant((qulonglong)m_pathCache->invalidations());
+
+        } else if (feature[1] == "hitRate") {
+            return QDBusVariant(hits + misses == 0 ? 0.0
+                                                   : double(hits) / (hits + misses));
+        }
+
+        return QDBusVariant();
+    }
+
     if (feature[0] == "isOTR") {
         if (feature.size() != 2) return QDBusVariant(false);
 
@@ -710,10 +960,41 @@ void StatsPlugin::setFeatureValue(const QStringList &feature, const QDBusVariant
 QStringList StatsPlugin::listFeatures(const QStringList &feature) const
 {
     if (feature.isEmpty() || feature[0].isEmpty()) {
-        return { "isOTR/" };
+        return { "isOTR/", "pathCache/", "pipeline/", "resourceInfo/",
+                 "resourcePaths/", "databaseExecutor/", "databasePool/" };
 
     } else if (feature[0] == "isOTR") {
         return listActivities();
+
+    } else if (feature[0] == "pathCache") {
+        return { "hits", "misses", "invalidations", "hitRate" };
+
+    } else if (feature[0] == "pipeline") {
+        return { "events", "acceptedEvents", "validationTime",
+                 "filteringTime", "storingTime", "pendingWrites" };
+
+    } else if (feature[0] == "resourceInfo") {
+        return { "pending", "detected", "cacheHits", "updates", "writes",
+                 "statementsSaved", "lastBatchStatementsSaved" };
+
+    } else if (feature[0] == "resourcePaths") {
+        return { "hits", "misses" };
+
+    } else if (feature[0] == "databasePool") {
+        return { "size", "jobs", "waitTime", "utilization" };
+
+    } else if (feature[0] == "databaseExecutor") {
+        if (feature.size() == 1) {
+            QStringList methods;
+
+            for (const auto &method: m_executor->methods()) {
+                methods << method + '/';
+            }
+
+            return methods;
+        }
+
+        return { "calls", "queueTime", "runTime", "maxLatency" };
     }
 
     return QStringList();
@@ -19,19 +19,30 @@
 #define PLUGINS_SQLITE_STATS_PLUGIN_H
 
 // Qt
+#include <QDBusContext>
 #include <QObject>
+#include <QSet>
 #include <QTimer>
 
 // Boost and STL
+#include <atomic>
+#include <map>
 #include <memory>
+#include <vector>
 #include <boost/container/flat_set.hpp>
 
 // Local
 #include <Plugin.h>
+#include "ResourceInfoDetector.h"
+#include "UrlFilterMatcher.h"
 
 class QSqlQuery;
 class QFileSystemWatcher;
 class ResourceLinking;
+class CanonicalPathCache;
+class ResourceInfoWriter;
+class ResourcePathIndex;
+class DatabaseExecutor;
 
 /**
  * Communication with the outer world.
@@ -39,7 +50,7 @@ class ResourceLinking;
  * - Handles configuration
  * - Filters the events based on the user's configuration.
  */
-class StatsPlugin : public Plugin {
+class StatsPlugin : public Plugin, protected QDBusContext {
     Q_OBJECT
     // Q_CLASSINFO("D-Bus Interface", "org.kde.ActivityManager.Resources.Scoring")
     // Q_PLUGIN_METADATA(IID "org.kde.ActivityManager.plugins.sqlite")
@@ -47,6 +58,7 @@ class StatsPlugin : public Plugin {
 public:
     explicit StatsPlugin(QObject *parent = nullptr,
                          const QVariantList &args = QVariantList());
+    ~StatsPlugin() override;
 
     static StatsPlugin *self();
 
@@ -58,6 +70,16 @@ public:
     inline
     QObject *activitiesInterface() const { return m_activities; }
 
+    inline
+    CanonicalPathCache *canonicalPathCache() const { return m_pathCache; }
+
+    // Can be used only from the database writer thread
+    inline
+    ResourcePathIndex *resourcePathIndex() const { return m_pathIndex.get(); }
+
+    inline
+    DatabaseExecutor *databaseExecutor() const { return m_executor.get(); }
+
     bool isFeatureOperational(const QStringList &feature) const override;
     QStringList listFeatures(const QStringList &feature) const override;
 
@@ -110,16 +132,14 @@ private Q_SLOTS:
                             const QString &targettedResource,
                             const QDateTime &end);
 
-    void saveResourceTitle(const QString &uri, const QString &title,
-                           bool autoTitle = false);
-    void saveResourceMimetype(const QString &uri, const QString &mimetype,
-                              bool autoMimetype = false);
-    bool insertResourceInfo(const QString &uri);
-    void detectResourceInfo(const QString &uri);
+    void saveResourceTitle(const QString &uri, const QString &title);
+    void saveResourceMimetype(const QString &uri, const QString &mimetype);
+    void saveDetectedResourceInfo(const QList<ResourceInfoDetector::Info> &batch);
 
     void deleteOldEvents();
 
 private:
+    void detectResourceInfo(const QString &uri);
     inline bool acceptedEvent(const Event &event);
     inline Event validateEvent(Event event);
 
@@ -134,24 +154,58 @@ private:
     QObject *m_resources;
 
     boost::container::flat_set<QString> m_apps;
-    QList<QRegExp> m_urlFilters;
+    UrlFilterMatcher m_urlFilter;
     QStringList m_otrActivities;
 
+    // These are used only from the writer thread
     std::unique_ptr<QSqlQuery> openResourceEventQuery;
     std::unique_ptr<QSqlQuery> closeResourceEventQuery;
 
-    std::unique_ptr<QSqlQuery> insertResourceInfoQuery;
-    std::unique_ptr<QSqlQuery> getResourceInfoQuery;
-    std::unique_ptr<QSqlQuery> saveResourceTitleQuery;
-    std::unique_ptr<QSqlQuery> saveResourceMimetypeQuery;
+    // Keyed by the query string, used by the write
+    // jobs of the database executor
+    std::map<QString, std::unique_ptr<QSqlQuery>> m_deleteStatsForResourceQueries;
 
     QTimer m_deleteOldEventsTimer;
 
+    // The accepted events of the current batch, they are
+    // handed over to the writer thread to be stored
+    std::vector<Event> m_eventsToProcess;
+
+    // Counters for the stages of addEvents, they are
+    // read from the Features thread
+    struct PipelineStatistics {
+        PipelineStatistics()
+            : events(0)
+            , acceptedEvents(0)
+            , validationTime(0)
+            , filteringTime(0)
+            , storingTime(0)
+        {
+        }
+
+        std::atomic<quint64> events;
+        std::atomic<quint64> acceptedEvents;
+        std::atomic<quint64> validationTime; // ns
+        std::atomic<quint64> filteringTime;  // ns
+        std::atomic<quint64> storingTime;    // ns
+    } m_pipeline;
+
     bool m_blockedByDefault : 1;
     bool m_blockAll : 1;
     WhatToRemember m_whatToRemember : 2;
 
     ResourceLinking *m_resourceLinking;
+    CanonicalPathCache *m_pathCache;
+    ResourceInfoDetector *m_infoDetector;
+
+    // The resources whose info has already been looked up,
+    // so that the database is not asked on every event
+    QSet<QString> m_infoLookedUp;
+    ResourceInfoWriter *m_infoWriter;
+    std::unique_ptr<ResourcePathIndex> m_pathIndex;
+
+    // Destroyed first, the running jobs can use the members above
+    std::unique_ptr<DatabaseExecutor> m_executor;
 
     static StatsPlugin *s_instance;
 };
@@ -0,0 +1,168 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+// Self
+#include "UrlFilterMatcher.h"
+
+// STL
+#include <algorithm>
+
+// Local
+#include <common/database/Database.h>
+
+
+namespace {
+    QString reversed(QString string)
+    {
+        std::reverse(string.begin(), string.end());
+        return string;
+    }
+
+    // Sorts the list and removes the entries that start with another
+    // entry, after this at most one entry can be a prefix of a string
+    void makePrefixFree(std::vector<QString> &list)
+    {
+        std::sort(list.begin(), list.end());
+
+        std::vector<QString> result;
+
+        for (const auto &item: list) {
+            if (result.empty() || !item.startsWith(result.back())) {
+                result.push_back(item);
+            }
+        }
+
+        list.swap(result);
+    }
+
+    bool startsWithAny(const std::vector<QString> &prefixes,
+                       const QString &string)
+    {
+        auto candidate = std::upper_bound(prefixes.cbegin(), prefixes.cend(),
+                                          string);
+
+        // In a prefix-free list, only the greatest entry that is not
+        // greater than the string can be its prefix
+        return candidate != prefixes.cbegin()
+               && string.startsWith(*--candidate);
+    }
+
+    // Splits the pattern on the stars that are not escaped. The escaped
+    // characters are kept as they are, like parseStarPattern does
+    QStringList splitOnStars(const QString &pattern)
+    {
+        QStringList result;
+        QString current;
+        bool isEscaped = false;
+
+        for (const auto &character: pattern) {
+            if (isEscaped) {
+                isEscaped = false;
+
+            } else if (character == QLatin1Char('\\')) {
+                isEscaped = true;
+
+            } else if (character == QLatin1Char('*')) {
+                result << current;
+                current.clear();
+                continue;
+            }
+
+            current += character;
+        }
+
+        result << current;
+
+        return result;
+    }
+}
+
+UrlFilterMatcher::UrlFilterMatcher()
+    : m_hasRest(false)
+{
+}
+
+UrlFilterMatcher::UrlFilterMatcher(const QStringList &patterns)
+    : m_hasRest(false)
+{
+    QStringList rest;
+
+    for (const auto &pattern: patterns) {
+        const auto parts = splitOnStars(pattern);
+
+        if (parts.size() == 1) {
+            m_exact << parts[0];
+
+        } else if (parts.size() == 2 && parts[1].isEmpty()) {
+            m_prefixes.push_back(parts[0]);
+
+        } else if (parts.size() == 2 && parts[0].isEmpty()) {
+            m_reversedSuffixes.push_back(reversed(parts[1]));
+
+        } else if (parts.size() == 3 && parts[0].isEmpty()
+                   && parts[2].isEmpty()) {
+            m_infixes.emplace_back(parts[1]);
+
+        } else {
+            rest << Common::parseStarPattern(pattern, QStringLiteral(".*"),
+                [] (const QString &part) {
+                    return QRegularExpression::escape(part);
+                });
+        }
+    }
+
+    makePrefixFree(m_prefixes);
+    makePrefixFree(m_reversedSuffixes);
+
+    if (!rest.isEmpty()) {
+        m_hasRest = true;
+        m_rest.setPattern(QStringLiteral("\\A(?:")
+                          + rest.join(QLatin1Char('|'))
+                          + QStringLiteral(")\\z"));
+        m_rest.setPatternOptions(QRegularExpression::DotMatchesEverythingOption);
+        m_rest.optimize();
+    }
+}
+
+bool UrlFilterMatcher::isEmpty() const
+{
+    return m_exact.isEmpty() && m_prefixes.empty()
+           && m_reversedSuffixes.empty() && m_infixes.empty() && !m_hasRest;
+}
+
+bool UrlFilterMatcher::matches(const QString &uri) const
+{
+    if (m_exact.contains(uri) || startsWithAny(m_prefixes, uri)) {
+        return true;
+    }
+
+    if (!m_reversedSuffixes.empty()
+        && startsWithAny(m_reversedSuffixes, reversed(uri))) {
+        return true;
+    }
+
+    for (const auto &infix: m_infixes) {
+        if (infix.indexIn(uri) != -1) {
+            return true;
+        }
+    }
+
+    return m_hasRest && m_rest.match(uri).hasMatch();
+}
+
@@ -0,0 +1,63 @@
+/*
+ *   Copyright (C) 2016 by Ivan Cukic <ivan.cukic@kde.org>
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License version 2,
+ *   or (at your option) any later version, as published by the Free
+ *   Software Foundation
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details
+ *
+ *   You should have received a copy of the GNU General Public
+ *   License along with this program; if not, write to the
+ *   Free Software Foundation, Inc.,
+ *   51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA.
+ */
+
+#ifndef PLUGINS_SQLITE_URL_FILTER_MATCHER_H
+#define PLUGINS_SQLITE_URL_FILTER_MATCHER_H
+
+// Qt
+#include <QRegularExpression>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QStringMatcher>
+
+// STL
+#include <vector>
+
+/**
+ * Matches the URIs against a list of star patterns (the url-filters
+ * setting). The patterns have the same meaning as with
+ * Common::starPatternToRegex, but the common shapes are matched
+ * without the regular expression engine:
+ *
+ *  - patterns without stars are looked up in a hash set,
+ *  - "prefix*" and "*suffix" are looked up with a binary search
+ *    in sorted lists from which the redundant entries are removed,
+ *  - "*infix*" is matched with QStringMatcher,
+ *  - everything else is compiled into one regular expression.
+ */
+class UrlFilterMatcher {
+public:
+    UrlFilterMatcher();
+    explicit UrlFilterMatcher(const QStringList &patterns);
+
+    bool matches(const QString &uri) const;
+
+    bool isEmpty() const;
+
+private:
+    QSet<QString> m_exact;
+    std::vector<QString> m_prefixes;
+    std::vector<QString> m_reversedSuffixes;
+    std::vector<QStringMatcher> m_infixes;
+    QRegularExpression m_rest;
+    bool m_hasRest;
+};
+
+#endif // PLUGINS_SQLITE_URL_FILTER_MATCHER_H
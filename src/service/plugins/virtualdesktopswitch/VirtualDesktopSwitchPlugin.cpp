@@ -21,9 +21,13 @@
 
 #include <kwindowsystem.h>
 
+#include <ActivitiesSnapshot.h>
+#include <SwitchTrace.h>
+
 KAMD_EXPORT_PLUGIN(virtualdesktopswitchplugin, VirtualDesktopSwitchPlugin, "kactivitymanagerd-plugin-virtualdesktopswitch.json")
 
 const auto configPattern = QStringLiteral("desktop-for-%1");
+const auto currentActivityEntry = QStringLiteral("currentActivity");
 
 VirtualDesktopSwitchPlugin::VirtualDesktopSwitchPlugin(QObject *parent, const QVariantList &args)
     : Plugin(parent)
@@ -44,14 +48,33 @@ bool VirtualDesktopSwitchPlugin::init(QHash<QString, QObject *> &modules)
 
     m_activitiesService = modules["activities"];
 
-    m_currentActivity = Plugin::retrieve<QString>(
-        m_activitiesService, "CurrentActivity", "QString");
-
     connect(m_activitiesService, SIGNAL(CurrentActivityChanged(QString)),
             this, SLOT(currentActivityChanged(QString)));
     connect(m_activitiesService, SIGNAL(ActivityRemoved(QString)),
             this, SLOT(activityRemoved(QString)));
 
+    // The plugin is loaded after the activity switch or the removal
+    // that triggered it, catching up with them. The activity that was
+    // current when the plugin saw the last switch is in the config
+    const auto snapshot = ActivitiesSnapshot::current();
+
+    const auto desktopPrefix = configPattern.arg(QString());
+
+    for (const auto &key: config().keyList()) {
+        if (key.startsWith(desktopPrefix)
+                && !snapshot->activities.contains(key.mid(desktopPrefix.length()))) {
+            config().deleteEntry(key);
+        }
+    }
+
+    m_currentActivity = config().readEntry(currentActivityEntry, QString());
+
+    if (!snapshot->activities.contains(m_currentActivity)) {
+        m_currentActivity.clear();
+    }
+
+    currentActivityChanged(snapshot->currentActivity);
+
     return true;
 }
 
@@ -61,12 +84,18 @@ void VirtualDesktopSwitchPlugin::currentActivityChanged(const QString &activity)
         return;
     }
 
-    config().writeEntry(
-        configPattern.arg(m_currentActivity),
-        QString::number(KWindowSystem::currentDesktop()));
+    SwitchTrace::Handler trace(activity, QStringLiteral("virtualdesktopswitch"));
+
+    if (!m_currentActivity.isEmpty()) {
+        config().writeEntry(
+            configPattern.arg(m_currentActivity),
+            QString::number(KWindowSystem::currentDesktop()));
+    }
 
     m_currentActivity = activity;
 
+    config().writeEntry(currentActivityEntry, m_currentActivity);
+
     const auto desktopId = config().readEntry(configPattern.arg(m_currentActivity), -1);
 
     if (desktopId <= KWindowSystem::numberOfDesktops() && desktopId >= 0) {